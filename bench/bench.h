@@ -0,0 +1,45 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_ROM_SIZE 0x8000 //32 KiB, no MBC
+
+static inline double bench_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//xorshift32, the same sequence on every host
+static inline uint32_t bench_random(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+//copy code at address in the rom
+static inline void bench_rom_code(uint8_t* rom, uint16_t address, const uint8_t* code, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; i++) { rom[address + i] = code[i]; }
+}
+
+static inline void bench_rom_save(const char* path, const uint8_t* rom, uint32_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(rom, 1, size, file) != size) {
+        fprintf(stderr, "[ERROR]: can not write %s\n", path);
+        abort();
+    }
+    fclose(file);
+}
+
+#endif //__BENCH_H__
@@ -0,0 +1,15 @@
+#!/bin/sh
+#usage: bench/bench.sh [cpu | memory | ppu] [options of the program]
+#builds a -O2 headless copy of the tree in a scratch directory, so the objects of the tree are left alone
+set -e
+program=bench_cpu
+case "$1" in
+    cpu|memory|ppu) program=bench_$1; shift ;;
+esac
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+build=$(mktemp -d /tmp/dmgemu_build_XXXXXX)
+trap 'rm -rf "$build"' EXIT
+cp -r "$root/src" "$root/bench" "$root/Makefile" "$build"
+make -s -C "$build" HEADLESS=1 FLAGS="-O2 -g" "bench/$program"
+"$build/bench/$program" "$@"
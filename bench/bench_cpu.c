@@ -0,0 +1,316 @@
+#include "bench.h"
+#include "gameboy.h"
+#include <string.h>
+#include <unistd.h>
+
+//CPU workloads on generated ROMs: guest cycles and instructions per host second, best of the runs.
+//Build and run with bench/bench.sh, or make bench FLAGS=-O2 HEADLESS=1 and bench/bench_cpu [options] [workload...]
+
+#define BENCH_MBC_BANKS 64
+
+typedef struct {
+    const char* name;
+    const char* about;
+    uint32_t rom_size;
+    void (*build)(uint8_t* rom);
+} Workload;
+
+//header and entry point of a 32 KiB ROM without MBC, the code starts at 0x0150
+static void bench_rom_header(uint8_t* rom)
+{
+    static const uint8_t entry[] = { 0xC3, 0x50, 0x01 }; //JP 0150
+    bench_rom_code(rom, 0x0100, entry, sizeof(entry));
+    rom[0x147] = 0x00;
+    rom[0x148] = 0x00;
+    rom[0x149] = 0x00;
+}
+
+//every opcode group once per iteration: LD r,r', ALU r/(HL)/n, INC/DEC, CB, PUSH/POP, CALL/RET, LDH
+static void bench_build_dispatch(uint8_t* rom)
+{
+    static const uint8_t code[] = {
+        0x31, 0xF0, 0xFF, //LD SP,FFF0
+        0x06, 0x00, //outer: LD B,00
+        0x21, 0x00, 0xC0, //loop: LD HL,C000
+        0x79, 0x4A, 0x53, 0x5C, 0x77, 0x7E, 0x86, 0x34, //LD A,C; LD C,D; LD D,E; LD E,H; LD (HL),A; LD A,(HL); ADD (HL); INC (HL)
+        0x0E, 0x12, 0x81, 0x92, 0xA3, 0xAC, 0xB5, 0xBF, //LD C,12; ADD C; SUB D; AND E; XOR H; OR L; CP A
+        0x3C, 0x0D, 0x14, 0x1D, 0xC6, 0x07, 0xDE, 0x03, //INC A; DEC C; INC D; DEC E; ADD 07; SBC 03
+        0xCB, 0x11, 0xCB, 0x2A, 0xCB, 0x33, 0xCB, 0x47, //RL C; SRA D; SWAP E; BIT 0,A
+        0xCB, 0xC7, 0xCB, 0x87, //SET 0,A; RES 0,A
+        0xC5, 0xD5, 0xD1, 0xC1, 0x09, 0x13, //PUSH BC; PUSH DE; POP DE; POP BC; ADD HL,BC; INC DE
+        0x2F, 0x37, 0x3F, 0x17, 0x0F, //CPL; SCF; CCF; RLA; RRCA
+        0xE0, 0x80, 0xF0, 0x80, 0x00, //LDH (80),A; LDH A,(80); NOP
+        0xCD, 0x00, 0x02, //CALL 0200
+        0x05, 0x20, 0xC3, //DEC B; JR NZ,loop
+        0xC3, 0x53, 0x01 //JP outer
+    };
+    static const uint8_t routine[] = { 0x3C, 0xC9 }; //INC A; RET
+
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0150, code, sizeof(code));
+    bench_rom_code(rom, 0x0200, routine, sizeof(routine));
+}
+
+//self-modifying code: 16 stores into a cached WRAM routine per iteration, with 1024 ROM blocks in the cache
+static void bench_build_smc(uint8_t* rom)
+{
+    static const uint8_t start[] = {
+        0x31, 0xF0, 0xFF, //LD SP,FFF0
+        0x21, 0x00, 0xC0, 0x36, 0x3E, 0x2C, 0x36, 0x00, 0x2C, 0x36, 0xC9 //C000: LD A,00; RET
+    };
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0150, start, sizeof(start));
+
+    uint16_t address = 0x0150 + sizeof(start);
+    uint16_t loop = address;
+    static const uint8_t pointer[] = { 0x21, 0x01, 0xC0 }; //loop: LD HL,C001
+    bench_rom_code(rom, address, pointer, sizeof(pointer));
+    address += sizeof(pointer);
+    for (uint32_t i = 0; i < 16; i++) {
+        static const uint8_t store[] = { 0x34, 0xCD, 0x00, 0xC0 }; //INC (HL): the LD operand; CALL C000
+        bench_rom_code(rom, address, store, sizeof(store));
+        address += sizeof(store);
+    }
+    static const uint8_t chain[] = { 0xCD, 0x00, 0x10 }; //CALL 1000
+    bench_rom_code(rom, address, chain, sizeof(chain));
+    address += sizeof(chain);
+    rom[address] = 0x18; //JR loop
+    rom[address + 1] = (uint8_t)(loop - (address + 2));
+
+    for (uint32_t i = 0; i < 1024; i++) { //NOP; JR +0: one block each
+        rom[0x1000 + i * 3] = 0x00;
+        rom[0x1000 + i * 3 + 1] = 0x18;
+        rom[0x1000 + i * 3 + 2] = 0x00;
+    }
+    rom[0x1000 + 1024 * 3] = 0xC9; //RET
+}
+
+//8-bit ALU operations and CB shifts in a DEC B/JR NZ loop: lazy flags, only JR NZ reads Z
+static void bench_build_alu(uint8_t* rom)
+{
+    static const uint8_t code[] = {
+        0x31, 0xF0, 0xFF, 0x06, 0x00, //LD SP,FFF0; LD B,00
+        0x81, 0x8A, 0x93, 0xAB, 0x24, 0x2D, 0xB8, 0xA1, //loop: ADD C; ADC D; SUB E; XOR E; INC H; DEC L; CP B; AND C
+        0xB2, 0x9B, 0xCB, 0x01, 0x3C, 0xFE, 0x10, 0xCB, //OR D; SBC E; RLC C; INC A; CP 10
+        0x3A, 0x0C, 0x15, 0x89, //SRL D; INC C; DEC D; ADC C
+        0x05, 0x20, 0xE9, //DEC B; JR NZ,loop
+        0xC3, 0x50, 0x01 //JP 0150
+    };
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0150, code, sizeof(code));
+}
+
+//EI/HALT loop woken by the timer at 262144 Hz (TIMA reloads from F0): HALT fast-forward
+static void bench_build_halt(uint8_t* rom)
+{
+    static const uint8_t isr[] = { 0x3C, 0xD9 }; //INC A; RETI
+    static const uint8_t code[] = {
+        0x31, 0xFE, 0xFF, 0x3E, 0x05, 0xE0, 0x07, //LD SP,FFFE; TAC = 05
+        0x3E, 0xF0, 0xE0, 0x06, 0x3E, 0x04, 0xE0, 0xFF, //TMA = F0; IE = timer
+        0xAF, 0xFB, //XOR A; EI
+        0x76, 0x00, 0xEA, 0x00, 0xC0, 0x04, //loop: HALT; NOP; LD (C000),A; INC B
+        0x18, 0xF8 //JR loop
+    };
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0050, isr, sizeof(isr));
+    bench_rom_code(rom, 0x0150, code, sizeof(code));
+}
+
+//polling of a HRAM flag that a timer interrupt sets, then of LY up to line 0x90: idle loop skip
+static void bench_build_idle(uint8_t* rom)
+{
+    static const uint8_t isr[] = { 0x3E, 0x01, 0xE0, 0x80, 0x0C, 0xD9 }; //LD A,01; LDH (80),A; INC C; RETI
+    static const uint8_t code[] = {
+        0x31, 0xFE, 0xFF, 0x3E, 0x05, 0xE0, 0x07, //LD SP,FFFE; TAC = 05
+        0x3E, 0x04, 0xE0, 0xFF, 0xFB, //IE = timer; EI
+        0xAF, 0xE0, 0x80, //top: XOR A; LDH (80),A
+        0xF0, 0x80, 0xA7, 0x28, 0xFB, //loop: LDH A,(80); AND A; JR Z,loop
+        0xF0, 0x44, 0xFE, 0x90, 0x20, 0xFA, //ly: LDH A,(44); CP 90; JR NZ,ly
+        0x04, 0xC3, 0x5C, 0x01 //INC B; JP top
+    };
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0050, isr, sizeof(isr));
+    bench_rom_code(rom, 0x0150, code, sizeof(code));
+}
+
+//loads and stores over ROM, WRAM and HRAM in a DEC B/JR NZ loop: page table against the decoder
+static void bench_build_mem(uint8_t* rom)
+{
+    static const uint8_t code[] = {
+        0x31, 0xF0, 0xFF, //LD SP,FFF0
+        0x21, 0x00, 0x02, 0x11, 0x00, 0xC1, 0x06, 0x00, //outer: LD HL,0200; LD DE,C100; LD B,00
+        0x2A, 0x12, 0x13, 0x1A, 0xE0, 0x80, 0xF0, 0x81, //loop: LD A,(HL+); LD (DE),A; INC DE; LD A,(DE); LDH (80),A; LDH A,(81)
+        0x4E, 0x12, 0x05, //LD C,(HL); LD (DE),A; DEC B
+        0x20, 0xF3, //JR NZ,loop
+        0xC3, 0x53, 0x01 //JP outer
+    };
+    bench_rom_header(rom);
+    bench_rom_code(rom, 0x0150, code, sizeof(code));
+}
+
+//64 banks of 16 KiB and 32 KiB of external RAM. Each iteration maps the ROM and RAM banks picked by D, calls the
+//routine at 7000 of the bank and the one at 0200 of bank 0 (of bank 0x20/0x40/0x60 in MBC1 mode 1 too)
+static void bench_build_mbc(uint8_t* rom, uint8_t type)
+{
+    uint8_t code[64];
+    uint32_t size = 0;
+    static const uint8_t start[] = { 0x31, 0xF0, 0xFF, 0x3E, 0x0A, 0xEA, 0x00, 0x00, 0x16, 0x00 }; //LD SP,FFF0; RAM on; LD D,00
+    static const uint8_t rom_bank[] = { 0x7A, 0xEA, 0x00, 0x21 }; //loop: LD A,D; LD (2100),A
+    static const uint8_t rom_bank_high[] = { 0xE6, 0x01, 0xEA, 0x00, 0x31 }; //AND 01; LD (3100),A: bit 8 of the MBC5 bank
+    static const uint8_t ram_bank[] = { 0x7A, 0xE6, 0x03, 0xEA, 0x00, 0x40, 0xCD, 0x00, 0x70 }; //LD A,D; AND 03; LD (4000),A; CALL 7000
+    static const uint8_t mode1[] = { //mode 1: bank 0 area mapped from the bits of 4000, CALL 0200 there, back to mode 0
+        0x3E, 0x01, 0xEA, 0x00, 0x60, 0x7A, 0xE6, 0x03, 0xEA, 0x00, 0x40, 0xCD, 0x00, 0x02, 0x3E, 0x00, 0xEA, 0x00, 0x60
+    };
+    static const uint8_t tail[] = { 0xCD, 0x00, 0x02, 0x14 }; //CALL 0200; INC D
+
+    memcpy(&code[size], start, sizeof(start));
+    size += sizeof(start);
+    uint16_t loop = 0x0150 + size;
+    memcpy(&code[size], rom_bank, sizeof(rom_bank));
+    size += sizeof(rom_bank);
+    if (type == 0x1B) { memcpy(&code[size], rom_bank_high, sizeof(rom_bank_high)); size += sizeof(rom_bank_high); }
+    memcpy(&code[size], ram_bank, sizeof(ram_bank));
+    size += sizeof(ram_bank);
+    if (type == 0x03) { memcpy(&code[size], mode1, sizeof(mode1)); size += sizeof(mode1); }
+    memcpy(&code[size], tail, sizeof(tail));
+    size += sizeof(tail);
+    code[size] = 0x18; //JR loop
+    code[size + 1] = (uint8_t)(loop - (0x0150 + size + 2));
+    size += 2;
+
+    bench_rom_header(rom);
+    rom[0x147] = type;
+    rom[0x148] = 0x05; //1 MiB
+    rom[0x149] = 0x03; //32 KiB of RAM
+    bench_rom_code(rom, 0x0150, code, size);
+
+    for (uint32_t bank = 0; bank < BENCH_MBC_BANKS; bank++) {
+        uint8_t* base = &rom[bank * 0x4000];
+        const uint8_t routine[] = { //7000: A = bank ^ B, B = A, add and store it in the RAM bank
+            0x3E, (uint8_t)bank, 0xA8, 0x47, 0x21, 0x00, 0xA0, 0x86, 0x77, 0x80, 0x4F, 0xC9
+        };
+        const uint8_t routine0[] = { 0x3E, (uint8_t)(bank * 3), 0x81, 0x4F, 0xC9 }; //0200: A = 3 * bank + C, C = A
+        memcpy(&base[0x3000], routine, sizeof(routine));
+        memcpy(&base[0x0200], routine0, sizeof(routine0));
+        if (bank) { memcpy(&base[0x0100], &rom[0x0100], 0x50 + size); } //the main loop stays under MBC1 mode 1
+    }
+}
+
+static void bench_build_mbc1(uint8_t* rom) { bench_build_mbc(rom, 0x03); }
+static void bench_build_mbc5(uint8_t* rom) { bench_build_mbc(rom, 0x1B); }
+
+static const Workload workloads[] = {
+    { "dispatch", "mix of every opcode group, decoder bound", BENCH_ROM_SIZE, bench_build_dispatch },
+    { "smc", "stores into cached WRAM code, 1024 other blocks cached", BENCH_ROM_SIZE, bench_build_smc },
+    { "alu", "tight ALU loop, flags computed lazily", BENCH_ROM_SIZE, bench_build_alu },
+    { "halt", "EI/HALT woken by the timer, HALT fast-forward", BENCH_ROM_SIZE, bench_build_halt },
+    { "idle", "HRAM flag and LY polling, idle loop skip", BENCH_ROM_SIZE, bench_build_idle },
+    { "mem", "ROM, WRAM and HRAM loads and stores, page table", BENCH_ROM_SIZE, bench_build_mem },
+    { "mbc1", "MBC1 ROM/RAM bank switching, mode 1 bank 0 remap", BENCH_MBC_BANKS * 0x4000, bench_build_mbc1 },
+    { "mbc5", "MBC5 ROM/RAM bank switching", BENCH_MBC_BANKS * 0x4000, bench_build_mbc5 },
+};
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+typedef struct {
+    uint64_t cycles; //guest cycles per run
+    uint32_t runs;
+    JitMode jit_mode;
+    bool no_cache; //decode every opcode from the bus
+} BenchOptions;
+
+static Gameboy* bench_gameboy(const char* path, Frontend* frontend, const BenchOptions* options)
+{
+    Gameboy* gb = gameboy_create(path, frontend, options->jit_mode, SAVE_NONE, BOOT_INSTANT);
+    if (!gb) { fprintf(stderr, "[ERROR]: can not run %s\n", path); abort(); }
+    if (options->no_cache) {
+        gb->cpu.block_cache = NULL;
+        gb->cpu.jit = NULL;
+        gb->memory.block_cache = NULL;
+    }
+    return gb;
+}
+
+//best time of the runs through the run loop, and the instructions of one run stepped with cpu_ticks
+static void bench_workload(const Workload* workload, const char* path, Frontend* frontend, const BenchOptions* options)
+{
+    double best = 1e30;
+    for (uint32_t run = 0; run < options->runs; run++) {
+        Gameboy* gb = bench_gameboy(path, frontend, options);
+        double start = bench_seconds();
+        gameboy_run(gb, 0, options->cycles);
+        double elapsed = bench_seconds() - start;
+        if (elapsed < best) { best = elapsed; }
+        gameboy_destroy(gb);
+    }
+
+    uint64_t instructions = 0;
+    Gameboy* gb = bench_gameboy(path, frontend, options);
+    gb->cpu.jit = NULL; //one cpu_ticks per instruction
+    double start = bench_seconds();
+    while (gb->scheduler.now < options->cycles) {
+        while (gb->scheduler.now < gb->scheduler.next) {
+            gb->scheduler.now += cpu_ticks(&gb->cpu);
+            instructions++;
+        }
+        gameboy_handle_events(gb);
+    }
+    double stepped = bench_seconds() - start;
+    gameboy_destroy(gb);
+
+    printf("%-10s %8.1f M cycles/s %7.1fx real time %8.1f M instr/s   %s\n", workload->name,
+           options->cycles / best * 1e-6, options->cycles / (best * 4194304.0), instructions / stepped * 1e-6, workload->about);
+}
+
+int main(int ac, char** av)
+{
+    BenchOptions options = { .cycles = 50000000, .runs = 5, .jit_mode = JIT_OFF, .no_cache = false };
+    bool selected[WORKLOAD_COUNT] = { false };
+    bool any = false;
+
+    for (int i = 1; i < ac; i++) {
+        if (strcmp(av[i], "--cycles") == 0 && i + 1 < ac) { options.cycles = strtoull(av[++i], NULL, 10); }
+        else if (strcmp(av[i], "--runs") == 0 && i + 1 < ac) { options.runs = strtoul(av[++i], NULL, 10); }
+        else if (strcmp(av[i], "--jit") == 0) { options.jit_mode = JIT_ON; }
+        else if (strcmp(av[i], "--no-cache") == 0) { options.no_cache = true; }
+        else {
+            uint32_t w = 0;
+            while (w < WORKLOAD_COUNT && strcmp(av[i], workloads[w].name) != 0) { w++; }
+            if (w == WORKLOAD_COUNT) {
+                fprintf(stderr, "usage: %s [--cycles n] [--runs n] [--jit | --no-cache] [workload...]\nworkloads:", av[0]);
+                for (w = 0; w < WORKLOAD_COUNT; w++) { fprintf(stderr, " %s", workloads[w].name); }
+                fprintf(stderr, "\n");
+                return 1;
+            }
+            selected[w] = true;
+            any = true;
+        }
+    }
+    if (!options.runs || !options.cycles) { return 1; }
+
+    char dir[] = "/tmp/dmgemu_bench_XXXXXX";
+    if (!mkdtemp(dir)) { fprintf(stderr, "[ERROR]: can not create a directory for the ROMs\n"); return 1; }
+
+    Frontend frontend;
+    if (!frontend_open(&frontend, FRONTEND_HEADLESS, 0, false)) { return 1; }
+
+    printf("%lu cycles per run, best of %u, %s\n", (unsigned long)options.cycles, options.runs,
+           (options.no_cache) ? "no block cache" : (options.jit_mode == JIT_ON) ? "jit" : "block cache");
+    for (uint32_t w = 0; w < WORKLOAD_COUNT; w++) {
+        if (any && !selected[w]) { continue; }
+
+        char path[sizeof(dir) + 32];
+        snprintf(path, sizeof(path), "%s/%s.gb", dir, workloads[w].name);
+        uint8_t* rom = calloc(workloads[w].rom_size, 1);
+        if (!rom) { abort(); }
+        workloads[w].build(rom);
+        bench_rom_save(path, rom, workloads[w].rom_size);
+        free(rom);
+
+        bench_workload(&workloads[w], path, &frontend, &options);
+        unlink(path);
+    }
+
+    frontend_close(&frontend);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+#include "gameboy.h"
+#include <string.h>
+#include <unistd.h>
+
+//guest memory accesses: memory_read8/memory_write8 through the page table against memory_read_unmapped/
+//memory_write_unmapped, the decoder every access went through before it, on the same random addresses.
+//Build and run with bench/bench.sh memory, or make bench FLAGS=-O2 HEADLESS=1 and bench/bench_memory [options]
+
+#define BENCH_ADDRESSES 4096
+
+typedef struct {
+    const char* name;
+    const char* about;
+    uint16_t (*address)(uint32_t random);
+} Region;
+
+static uint16_t bench_address_rom(uint32_t random) { return random & 0x7FFF; }
+static uint16_t bench_address_wram(uint32_t random) { return 0xC000 | (random & 0x1FFF); }
+static uint16_t bench_address_echo(uint32_t random) { return 0xE000 + (random % 0x1E00); }
+static uint16_t bench_address_hram(uint32_t random) { return 0xFF80 | (random % 0x7F); }
+static uint16_t bench_address_mix(uint32_t random)
+{
+    switch (random >> 30) {
+        case 0: { return bench_address_rom(random); }
+        case 1: { return bench_address_wram(random); }
+        case 2: { return bench_address_echo(random); }
+        default: { return bench_address_hram(random); }
+    }
+}
+
+static const Region regions[] = {
+    { "rom", "ROM bank 0 and 1, read only", bench_address_rom },
+    { "wram", "work ram", bench_address_wram },
+    { "echo", "echo of the work ram", bench_address_echo },
+    { "hram", "high ram, decoded on both paths", bench_address_hram },
+    { "mix", "the four regions above", bench_address_mix },
+};
+
+#define REGION_COUNT (sizeof(regions) / sizeof(regions[0]))
+
+//read every address then write it back plus one where it is ram, returns the seconds taken
+static double bench_page_table(Memory* memory, const uint16_t* addresses, uint32_t rounds, uint32_t* sum)
+{
+    double start = bench_seconds();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t i = 0; i < BENCH_ADDRESSES; i++) {
+            uint8_t data = memory_read8(memory, addresses[i]);
+            *sum += data;
+            if (addresses[i] >= 0xC000) { memory_write8(memory, addresses[i], data + 1); }
+        }
+    }
+    return bench_seconds() - start;
+}
+
+static double bench_decoder(Memory* memory, const uint16_t* addresses, uint32_t rounds, uint32_t* sum)
+{
+    double start = bench_seconds();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t i = 0; i < BENCH_ADDRESSES; i++) {
+            uint8_t data = memory_read_unmapped(memory, addresses[i]);
+            *sum += data;
+            if (addresses[i] >= 0xC000) { memory->writes++; memory_write_unmapped(memory, addresses[i], data + 1); }
+        }
+    }
+    return bench_seconds() - start;
+}
+
+int main(int ac, char** av)
+{
+    uint32_t rounds = 2000;
+    uint32_t runs = 7;
+
+    for (int i = 1; i < ac; i++) {
+        if (strcmp(av[i], "--rounds") == 0 && i + 1 < ac) { rounds = strtoul(av[++i], NULL, 10); }
+        else if (strcmp(av[i], "--runs") == 0 && i + 1 < ac) { runs = strtoul(av[++i], NULL, 10); }
+        else {
+            fprintf(stderr, "usage: %s [--rounds n] [--runs n]\n", av[0]);
+            return 1;
+        }
+    }
+    if (!rounds || !runs) { return 1; }
+
+    //32 KiB ROM of random bytes, the cpu never runs
+    char path[] = "/tmp/dmgemu_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) { fprintf(stderr, "[ERROR]: can not create the ROM\n"); return 1; }
+    close(fd);
+    uint8_t* rom = malloc(BENCH_ROM_SIZE);
+    if (!rom) { abort(); }
+    uint32_t state = 0x2545F491;
+    for (uint32_t i = 0; i < BENCH_ROM_SIZE; i++) { rom[i] = bench_random(&state); }
+    memset(&rom[0x100], 0, 0x50); //header: no MBC, no title
+    bench_rom_save(path, rom, BENCH_ROM_SIZE);
+    free(rom);
+
+    Frontend frontend;
+    if (!frontend_open(&frontend, FRONTEND_HEADLESS, 0, false)) { return 1; }
+    Gameboy* gb = gameboy_create(path, &frontend, JIT_OFF, SAVE_NONE, BOOT_INSTANT);
+    unlink(path);
+    if (!gb) { fprintf(stderr, "[ERROR]: can not run the ROM\n"); return 1; }
+
+    printf("%u addresses per run, best of %u, ns per address: a read, and a write back in ram\n", rounds * BENCH_ADDRESSES, runs);
+    printf("%-6s %11s %9s %8s\n", "", "page table", "decoder", "speedup");
+    uint32_t sum = 0;
+    for (uint32_t r = 0; r < REGION_COUNT; r++) {
+        uint16_t addresses[BENCH_ADDRESSES];
+        state = 0x9E3779B9 + r;
+        for (uint32_t i = 0; i < BENCH_ADDRESSES; i++) { addresses[i] = regions[r].address(bench_random(&state)); }
+
+        double table = 1e30, decoder = 1e30;
+        for (uint32_t run = 0; run < runs; run++) { //alternate the two paths, the host load hits both
+            double elapsed = bench_page_table(&gb->memory, addresses, rounds, &sum);
+            if (elapsed < table) { table = elapsed; }
+            elapsed = bench_decoder(&gb->memory, addresses, rounds, &sum);
+            if (elapsed < decoder) { decoder = elapsed; }
+        }
+
+        double count = (double)rounds * BENCH_ADDRESSES;
+        printf("%-6s %11.2f %9.2f %7.2fx   %s\n", regions[r].name, table / count * 1e9, decoder / count * 1e9,
+               decoder / table, regions[r].about);
+    }
+    printf("checksum %08X\n", sum);
+
+    gameboy_destroy(gb);
+    frontend_close(&frontend);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+#include "ppu.h"
+#include <string.h>
+
+//compose kernels of the PPU: ppu_compose_scalar, ppu_compose_ssse3 and ppu_compose_avx2 on the same random lines.
+//Every kernel must give the framebuffer of the scalar one byte for byte, the exit status is 1 if one does not.
+//Build and run with bench/bench.sh ppu, or make bench FLAGS=-O2 HEADLESS=1 and bench/bench_ppu [options]
+
+#define BENCH_LINES 4096
+
+typedef void (*ComposeKernel)(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades);
+
+typedef struct {
+    const char* name;
+    ComposeKernel compose;
+    bool supported;
+} Kernel;
+
+//one scanline as ppu_render_line hands it to the kernels
+typedef struct {
+    uint8_t bg[SCREEN_WIDTH]; //color 0-3
+    uint8_t obj[SCREEN_WIDTH]; //color in bits 0-1, palette in bit 2, behind the background in bit 3, 0 without sprite
+    uint8_t bg_shades[16] __attribute__((aligned(16)));
+    uint8_t obj_shades[16] __attribute__((aligned(16)));
+} Line;
+
+static void bench_fill_lines(Line* lines)
+{
+    uint32_t state = 0x1B873593;
+    for (uint32_t i = 0; i < BENCH_LINES; i++) {
+        Line* line = &lines[i];
+        for (uint32_t x = 0; x < SCREEN_WIDTH; x++) {
+            uint32_t random = bench_random(&state);
+            line->bg[x] = random & 0x3;
+            line->obj[x] = (random >> 8) & 0xF;
+        }
+        uint32_t random = bench_random(&state);
+        memset(line->bg_shades, 0, sizeof(line->bg_shades));
+        memset(line->obj_shades, 0, sizeof(line->obj_shades));
+        for (uint8_t color = 0; color < 4; color++) {
+            line->bg_shades[color] = (random >> (color * 2)) & 0x3;
+            line->obj_shades[color] = (random >> (8 + color * 2)) & 0x3;
+            line->obj_shades[4 + color] = (random >> (16 + color * 2)) & 0x3;
+        }
+    }
+}
+
+//compose every line in framebuffer, returns the seconds taken
+static double bench_kernel(ComposeKernel compose, const Line* lines, uint8_t* framebuffer, uint32_t rounds)
+{
+    double start = bench_seconds();
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t i = 0; i < BENCH_LINES; i++) {
+            const Line* line = &lines[i];
+            compose(&framebuffer[i * SCREEN_WIDTH], line->bg, line->obj, line->bg_shades, line->obj_shades);
+        }
+    }
+    return bench_seconds() - start;
+}
+
+int main(int ac, char** av)
+{
+    uint32_t rounds = 200;
+    uint32_t runs = 7;
+
+    for (int i = 1; i < ac; i++) {
+        if (strcmp(av[i], "--rounds") == 0 && i + 1 < ac) { rounds = strtoul(av[++i], NULL, 10); }
+        else if (strcmp(av[i], "--runs") == 0 && i + 1 < ac) { runs = strtoul(av[++i], NULL, 10); }
+        else {
+            fprintf(stderr, "usage: %s [--rounds n] [--runs n]\n", av[0]);
+            return 1;
+        }
+    }
+    if (!rounds || !runs) { return 1; }
+
+    Kernel kernels[] = {
+        { "scalar", ppu_compose_scalar, true },
+#if defined(__x86_64__)
+        { "ssse3", ppu_compose_ssse3, __builtin_cpu_supports("ssse3") },
+        { "avx2", ppu_compose_avx2, __builtin_cpu_supports("avx2") },
+#endif
+    };
+    uint32_t count = sizeof(kernels) / sizeof(kernels[0]);
+
+    Line* lines = malloc(sizeof(Line) * BENCH_LINES);
+    uint8_t* expected = malloc(BENCH_LINES * SCREEN_WIDTH);
+    uint8_t* framebuffer = malloc(BENCH_LINES * SCREEN_WIDTH);
+    if (!lines || !expected || !framebuffer) { abort(); }
+    bench_fill_lines(lines);
+    bench_kernel(ppu_compose_scalar, lines, expected, 1);
+
+    int status = 0;
+    for (uint32_t k = 0; k < count; k++) {
+        if (!kernels[k].supported) { continue; }
+        memset(framebuffer, 0xFF, BENCH_LINES * SCREEN_WIDTH); //not a shade, a pixel left unwritten shows
+        bench_kernel(kernels[k].compose, lines, framebuffer, 1);
+        if (memcmp(framebuffer, expected, BENCH_LINES * SCREEN_WIDTH) != 0) {
+            uint32_t i = 0;
+            while (framebuffer[i] == expected[i]) { i++; }
+            fprintf(stderr, "[ERROR]: %s differs from scalar on line %u pixel %u: %u instead of %u\n", kernels[k].name,
+                    i / SCREEN_WIDTH, i % SCREEN_WIDTH, framebuffer[i], expected[i]);
+            kernels[k].supported = false;
+            status = 1;
+        }
+    }
+
+    double best[sizeof(kernels) / sizeof(kernels[0])];
+    for (uint32_t k = 0; k < count; k++) { best[k] = 1e30; }
+    for (uint32_t run = 0; run < runs; run++) { //the kernels take turns, the host load hits them all
+        for (uint32_t k = 0; k < count; k++) {
+            if (!kernels[k].supported) { continue; }
+            double elapsed = bench_kernel(kernels[k].compose, lines, framebuffer, rounds);
+            if (elapsed < best[k]) { best[k] = elapsed; }
+        }
+    }
+
+    printf("%u lines per run, best of %u, every kernel gives the scalar framebuffer: %s\n", rounds * BENCH_LINES, runs, (status) ? "no" : "yes");
+    printf("%-8s %10s %8s\n", "", "ns/line", "speedup");
+    for (uint32_t k = 0; k < count; k++) {
+        if (!kernels[k].supported) { printf("%-8s %10s\n", kernels[k].name, "-"); continue; }
+        printf("%-8s %10.2f %7.2fx\n", kernels[k].name, best[k] / ((double)rounds * BENCH_LINES) * 1e9, best[0] / best[k]);
+    }
+
+    free(lines);
+    free(expected);
+    free(framebuffer);
+    return status;
+}
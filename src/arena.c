@@ -0,0 +1,37 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+void arena_init(Arena* arena, size_t capacity)
+{
+    if (!arena) { fprintf(stderr, "[ERROR]: arena initialization failed from structure element"); abort(); }
+
+    arena->capacity = (capacity + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena->used = 0;
+    arena->base = mmap(NULL, arena->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (arena->base == MAP_FAILED) { fprintf(stderr, "[ERROR]: arena mmap failed"); abort(); }
+}
+
+//zeroed memory until the arena is released, nothing is freed on its own
+void* arena_alloc(Arena* arena, size_t size)
+{
+    if (!arena || !arena->base) { abort(); }
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > arena->capacity - arena->used) { fprintf(stderr, "[ERROR]: arena of %zu bytes is full", arena->capacity); abort(); }
+
+    void* data = arena->base + arena->used;
+    arena->used += size;
+    return data;
+}
+
+void arena_release(Arena* arena)
+{
+    if (!arena) { abort(); }
+
+    if (arena->base) { munmap(arena->base, arena->capacity); }
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,20 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define ARENA_ALIGN 64 //every allocation starts on its own cache line
+
+//one mapping holding everything an instance allocates, released at once. Pages are only backed once touched
+typedef struct {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+} Arena;
+
+void arena_init(Arena* arena, size_t capacity);
+void* arena_alloc(Arena* arena, size_t size);
+void arena_release(Arena* arena);
+
+#endif //__ARENA_H__
@@ -0,0 +1,264 @@
+#include "block_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//index of a WRAM/HRAM address in the code map, -1 for the other regions
+static int32_t code_map_index(uint16_t address)
+{
+    if (address >= 0xC000 && address <= 0xDFFF) { return address - 0xC000; }
+    if (address >= 0xFF80 && address <= 0xFFFE) { return WORKRAM_SIZE + (address - 0xFF80); }
+    return -1;
+}
+
+static void code_map_mark(BlockCache* cache, Block* block, bool covered)
+{
+    int32_t start = code_map_index(block->pc);
+    if (start < 0) { return; } //ROM block
+
+    for (int32_t i = start; i < start + (block->end_pc - block->pc); i++) {
+        if (covered) { cache->code_map[i >> 6] |= (1ULL << (i & 63)); }
+        else { cache->code_map[i >> 6] &= ~(1ULL << (i & 63)); }
+    }
+    if (covered && start < WORKRAM_SIZE) { //its writes must reach block_cache_write_notify
+        memory_write_protect(cache->bus, block->pc, true);
+        memory_write_protect(cache->bus, block->end_pc - 1, true);
+    }
+}
+
+//give back the direct write page of the work ram pages in [first, last] left without cached code
+static void code_map_unprotect(BlockCache* cache, uint32_t first, uint32_t last)
+{
+    for (uint32_t offset = first * CODE_PAGE_SIZE; offset <= last * CODE_PAGE_SIZE && offset < WORKRAM_SIZE; offset += 0x100) {
+        uint64_t* words = &cache->code_map[offset >> 6];
+        if (!(words[0] | words[1] | words[2] | words[3])) { memory_write_protect(cache->bus, 0xC000 + offset, false); }
+    }
+}
+
+//last address of the region holding pc, a block never crosses it. 0 if the code there is not cached
+static uint16_t region_end(BlockCache* cache, uint16_t pc)
+{
+    if (pc <= 0xFF && cache->bus->bootrom_mapped) { return 0; } //boot rom overlay, run once
+    if (cache->bus->dma_active && pc < 0xFF80) { return 0; } //OAM DMA holds the bus, the fetches read 0xFF until it ends
+    if (pc <= 0x3FFF) { return 0x3FFF; } //ROM bank 0
+    if (pc <= 0x7FFF) { return 0x7FFF; } //ROM bank 1-N
+    if (pc >= 0xC000 && pc <= 0xDFFF) { return 0xDFFF; } //WRAM
+    if (pc >= 0xFF80 && pc <= 0xFFFE) { return 0xFFFE; } //HRAM
+    return 0; //VRAM, external RAM, echo RAM, OAM, I/O
+}
+
+static uint16_t region_bank(BlockCache* cache, uint16_t pc)
+{
+    if (pc <= 0x3FFF) { return cache->bus->cartridge->rom0_bank; } //not 0 in MBC1 mode 1
+    if (pc <= 0x7FFF) { return cache->bus->cartridge->current_rom_bank; }
+    return 0;
+}
+
+static uint32_t block_hash(uint16_t pc, uint16_t rom_bank)
+{
+    return (pc ^ ((uint32_t)rom_bank << 5)) & (BLOCK_HASH_SIZE - 1);
+}
+
+//the pools live in the arena of the instance, they go away with it
+void block_cache_init(BlockCache* cache, Memory* memory, Arena* arena)
+{
+    if (!cache || !memory || !arena) { fprintf(stderr, "[ERROR]: block cache initialization failed from structure element"); abort(); }
+
+    cache->bus = memory;
+    cache->generation = 0;
+    cache->blocks = arena_alloc(arena, sizeof(Block) * BLOCK_POOL_SIZE);
+    cache->instrs = arena_alloc(arena, sizeof(DecodedInstr) * BLOCK_INSTR_POOL_SIZE);
+
+    block_cache_flush(cache);
+}
+
+void block_cache_flush(BlockCache* cache)
+{
+    if (!cache) { abort(); }
+
+    cache->current = NULL;
+    cache->index = 0;
+    cache->generation++;
+    cache->nbr_blocks = 0;
+    cache->nbr_instrs = 0;
+    memset(cache->hash, 0, sizeof(cache->hash));
+    memset(cache->code_map, 0, sizeof(cache->code_map));
+    memset(cache->code_pages, 0, sizeof(cache->code_pages));
+    code_map_unprotect(cache, 0, CODE_PAGE_COUNT - 1);
+}
+
+static Block* block_cache_lookup(BlockCache* cache, uint16_t pc, uint16_t rom_bank)
+{
+    for (Block* block = cache->hash[block_hash(pc, rom_bank)]; block; block = block->hash_next) {
+        if (block->pc == pc && block->rom_bank == rom_bank) { return block; }
+    }
+    return NULL;
+}
+
+//the block jumps back to its own start and does not touch the cpu state cpu_ticks handles between instructions
+static bool block_is_self_loop(Block* block)
+{
+    for (uint8_t i = 0; i < block->count; i++) {
+        uint8_t opcode = block->instr[i].opcode;
+        OpcodeHandler handler = block->instr[i].handler;
+        if (handler == opcode_table[opcode].handler && (opcode == 0x76 || opcode == 0x10 || opcode == 0xF3 || opcode == 0xFB))
+            return false;
+    }
+
+    DecodedInstr* last = &block->instr[block->count - 1];
+    if (last->handler != opcode_table[last->opcode].handler) { return false; } //CB opcode
+    switch (last->opcode) {
+        case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: { return (uint16_t)(block->end_pc + (int8_t)last->operand) == block->pc; } //JR
+        case 0xC3: case 0xC2: case 0xCA: case 0xD2: case 0xDA: { return last->operand == block->pc; } //JP
+        default: { return false; }
+    }
+}
+
+//decode the instructions from pc up to the first jump, the end of the region or BLOCK_MAX_INSTR
+static Block* block_cache_decode(BlockCache* cache, uint16_t pc, uint16_t rom_bank, uint16_t end)
+{
+    if (cache->nbr_blocks == BLOCK_POOL_SIZE || cache->nbr_instrs + BLOCK_MAX_INSTR > BLOCK_INSTR_POOL_SIZE)
+        block_cache_flush(cache);
+
+    Block* block = &cache->blocks[cache->nbr_blocks];
+    block->instr = &cache->instrs[cache->nbr_instrs];
+    block->count = 0;
+
+    uint32_t address = pc;
+    while (block->count < BLOCK_MAX_INSTR) {
+        uint8_t opcode = memory_read8(cache->bus, address);
+        const Opcode* op = &opcode_table[opcode];
+        if (address + op->length - 1 > end) { break; } //operand out of the region
+
+        DecodedInstr* instr = &block->instr[block->count];
+        instr->handler = op->handler;
+        instr->opcode = opcode;
+        instr->length = op->length;
+        switch (op->length) {
+            case 2: { instr->operand = memory_read8(cache->bus, address + 1); break; }
+            case 3: { instr->operand = memory_read16(cache->bus, address + 1); break; }
+            default: { instr->operand = 0; break; }
+        }
+
+        if (opcode == 0xCB) { //resolve the prefix now, the CB opcode is the operand
+            instr->opcode = instr->operand;
+            instr->handler = opcode_table_CB[instr->opcode].handler;
+            instr->operand = 0;
+        }
+
+        block->count++;
+        address += op->length;
+        if (op->jump) { break; }
+    }
+
+    if (block->count == 0) { return NULL; }
+
+    block->pc = pc;
+    block->end_pc = address;
+    block->rom_bank = rom_bank;
+    block->valid = true;
+    block->link[0] = NULL;
+    block->link[1] = NULL;
+    block->hits = 0;
+    block->native = NULL;
+    block->jit_rejected = false;
+    block->self_loop = block_is_self_loop(block);
+
+    uint32_t hash = block_hash(pc, rom_bank);
+    block->hash_next = cache->hash[hash];
+    cache->hash[hash] = block;
+    code_map_mark(cache, block, true);
+    int32_t start = code_map_index(pc);
+    if (start >= 0) {
+        block->page_next = cache->code_pages[start / CODE_PAGE_SIZE];
+        cache->code_pages[start / CODE_PAGE_SIZE] = block;
+    }
+
+    cache->nbr_blocks++;
+    cache->nbr_instrs += block->count;
+    return block;
+}
+
+//the current block ended: first instruction of the block at pc, through the links of the previous block or the hash
+const DecodedInstr* block_cache_fetch_block(BlockCache* cache, uint16_t pc)
+{
+    Block* block = cache->current;
+    uint16_t end = region_end(cache, pc);
+    if (!end) { cache->current = NULL; return NULL; }
+    uint16_t rom_bank = region_bank(cache, pc);
+
+    Block* next = NULL;
+    uint8_t slot = 0;
+    if (block) { //follow the chain of the block that just ended
+        slot = (pc == block->end_pc) ? 0 : 1;
+        next = block->link[slot];
+        if (next && (next->pc != pc || next->rom_bank != rom_bank || !next->valid)) { next = NULL; }
+    }
+
+    if (!next) {
+        uint32_t generation = cache->generation;
+        next = block_cache_lookup(cache, pc, rom_bank);
+        if (!next) { next = block_cache_decode(cache, pc, rom_bank, end); }
+
+        if (block && next && cache->generation == generation) { block->link[slot] = next; } //block not flushed by the decode
+    }
+
+    cache->current = next;
+    if (!next) { return NULL; }
+
+    cache->index = 1;
+    return &next->instr[0];
+}
+
+//a byte of WRAM/HRAM covered by cached code was written: drop every block holding it.
+//Only the blocks of its code page and the previous one can, the others are not looked at
+void block_cache_invalidate(BlockCache* cache, uint16_t ram_index)
+{
+    if (!cache) { abort(); }
+
+    uint32_t page = ram_index / CODE_PAGE_SIZE;
+    uint32_t first = (page) ? page - 1 : 0;
+    uint32_t last = (page + 1 < CODE_PAGE_COUNT) ? page + 1 : page;
+
+    for (uint32_t p = first; p <= page; p++) {
+        Block** link = &cache->code_pages[p];
+        while (*link) {
+            Block* block = *link;
+            int32_t start = code_map_index(block->pc);
+            if (ram_index < start || ram_index >= start + (block->end_pc - block->pc)) { link = &block->page_next; continue; }
+
+            *link = block->page_next;
+            block->valid = false;
+            code_map_mark(cache, block, false);
+            if (cache->current == block) { cache->current = NULL; }
+
+            Block** prev = &cache->hash[block_hash(block->pc, block->rom_bank)];
+            while (*prev != block) { prev = &(*prev)->hash_next; }
+            *prev = block->hash_next;
+        }
+    }
+
+    //blocks overlapping the dropped ones still cover some of the cleared bytes, they start one page around at most
+    for (uint32_t p = first; p <= last; p++) {
+        for (Block* block = cache->code_pages[p]; block; block = block->page_next) { code_map_mark(cache, block, true); }
+    }
+    code_map_unprotect(cache, first, last);
+}
+
+//the blocks stay keyed by their bank, only the block running from a bank switched out is left
+void block_cache_rom_bank_switched(BlockCache* cache)
+{
+    if (!cache) { abort(); }
+
+    if (cache->current && cache->current->rom_bank != region_bank(cache, cache->current->pc))
+        cache->current = NULL;
+}
+
+//OAM DMA holds the bus: a block running outside HRAM stops there, the next fetches read 0xFF
+void block_cache_dma_started(BlockCache* cache)
+{
+    if (!cache) { abort(); }
+
+    if (cache->current && cache->current->pc < 0xFF80)
+        cache->current = NULL;
+}
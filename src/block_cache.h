@@ -0,0 +1,85 @@
+#ifndef __BLOCK_CACHE_H__
+#define __BLOCK_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cpu.h"
+#include "memory.h"
+#include "arena.h"
+
+#define BLOCK_MAX_INSTR 32 //a block also ends at the first jump
+#define BLOCK_POOL_SIZE 4096
+#define BLOCK_INSTR_POOL_SIZE 0x8000
+#define BLOCK_HASH_SIZE 0x1000
+
+#define CODE_MAP_SIZE (WORKRAM_SIZE + 0x80) //one bit per byte of WRAM (index 0x0000) and HRAM (index 0x2000)
+#define CODE_PAGE_SIZE 0x100 //more than a block spans: the blocks holding a byte start in its page or the previous one
+#define CODE_PAGE_COUNT ((CODE_MAP_SIZE + CODE_PAGE_SIZE - 1) / CODE_PAGE_SIZE)
+
+typedef struct {
+    OpcodeHandler handler;
+    uint16_t operand; //n8, e8 or a16 already fetched
+    uint8_t opcode; //CB opcode for the prefixed instructions
+    uint8_t length;
+} DecodedInstr;
+
+typedef struct Block {
+    uint16_t pc; //address of the first instruction
+    uint16_t end_pc; //address after the last instruction
+    uint16_t rom_bank; //current_rom_bank when decoded for 0x4000-0x7FFF, rom0_bank for 0x0000-0x3FFF, 0 elsewhere
+    uint8_t count;
+    bool valid;
+    DecodedInstr* instr;
+
+    uint32_t hits; //entries counted by the JIT
+    void* native; //compiled block, NULL if not compiled
+    bool jit_rejected; //never compile this block
+    bool self_loop; //its last jump targets pc and it holds no HALT, STOP, EI or DI: candidate idle loop
+
+    struct Block* hash_next;
+    struct Block* page_next; //WRAM/HRAM blocks starting in the same code page
+    struct Block* link[2]; //successors chained after the last instruction: fall through / jump target
+} Block;
+
+typedef struct BlockCache {
+    Block* current; //block being executed
+    uint8_t index; //next instruction of current
+
+    Block* hash[BLOCK_HASH_SIZE];
+    Block* blocks; //pool of BLOCK_POOL_SIZE blocks
+    DecodedInstr* instrs; //pool of BLOCK_INSTR_POOL_SIZE decoded instructions shared by the blocks
+    uint32_t nbr_blocks;
+    uint32_t nbr_instrs;
+    uint32_t generation; //incremented on every flush
+
+    uint64_t code_map[CODE_MAP_SIZE / 64]; //bytes of WRAM/HRAM covered by a block
+    Block* code_pages[CODE_PAGE_COUNT]; //valid WRAM/HRAM blocks by the code page of their pc
+    Memory* bus;
+} BlockCache;
+
+void block_cache_init(BlockCache* cache, Memory* memory, Arena* arena);
+void block_cache_flush(BlockCache* cache);
+
+const DecodedInstr* block_cache_fetch_block(BlockCache* cache, uint16_t pc);
+void block_cache_invalidate(BlockCache* cache, uint16_t ram_index);
+void block_cache_rom_bank_switched(BlockCache* cache);
+void block_cache_dma_started(BlockCache* cache);
+
+//return the next predecoded instruction at pc or NULL if pc is in a region that is not cached
+static inline const DecodedInstr* block_cache_fetch(BlockCache* cache, uint16_t pc)
+{
+    Block* block = cache->current;
+    if (block && cache->index < block->count)
+        return &block->instr[cache->index++];
+
+    return block_cache_fetch_block(cache, pc);
+}
+
+//called on every write to WRAM/HRAM (ram_index as in code_map), only does work if the byte holds cached code
+static inline void block_cache_write_notify(BlockCache* cache, uint16_t ram_index)
+{
+    if (cache && (cache->code_map[ram_index >> 6] & (1ULL << (ram_index & 63))))
+        block_cache_invalidate(cache, ram_index);
+}
+
+#endif //__BLOCK_CACHE_H__
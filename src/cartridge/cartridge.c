@@ -17,152 +17,290 @@ static uint8_t rambank_number(uint8_t data) {
     }
 }
 
-static uint8_t rombank_number(uint8_t data) {
-    if (data <= 0x8)
-        return (2 << (data));
-    else
-        return 1;
-}
+//recompute the current banks and their host addresses from the bank registers
+static void cartridge_update_banks(Cartridge* cartridge) {
+    uint32_t rom_bank = 1;
+    uint32_t rom0_bank = 0;
+    uint32_t ram_bank = 0;
+
+    switch (cartridge->mbc) {
+        case MBC_NONE: { break; }
+        case MBC_1: {
+            rom_bank = (cartridge->bank_high << 5) | cartridge->bank_low;
+            if (cartridge->mode_flag) { rom0_bank = cartridge->bank_high << 5; ram_bank = cartridge->bank_high; } //mode 1: the 2 bits also bank 0x0000-0x3FFF and the RAM
+            break;
+        }
+        case MBC_2: { rom_bank = cartridge->bank_low; break; }
+        case MBC_3: { rom_bank = cartridge->bank_low; ram_bank = cartridge->ram_select; break; }
+        case MBC_5: { rom_bank = (cartridge->bank_high << 8) | cartridge->bank_low; ram_bank = cartridge->ram_select; break; }
+        default: { abort(); }
+    }
 
-void load_cartridge(Cartridge* cartridge,const char* filename) {
-    if (!cartridge || !filename) { abort(); }
+    cartridge->current_rom_bank = rom_bank & (cartridge->nbr_rom_bank - 1);
+    cartridge->rom0_bank = rom0_bank & (cartridge->nbr_rom_bank - 1);
+    cartridge->current_ram_bank = (cartridge->nbr_ram_bank) ? ram_bank % cartridge->nbr_ram_bank : 0;
 
-    FILE* file = fopen(filename, "rb");
-    if (!file) { fprintf(stderr, "Error: Cartridge not open"); abort(); }
+    cartridge->rom0 = cartridge->rom + ROM_BANK_SIZE * cartridge->rom0_bank;
+    cartridge->romx = cartridge->rom + ROM_BANK_SIZE * cartridge->current_rom_bank;
 
-    fseek(file, 0, SEEK_END);
-    cartridge->rom_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    bool plain_ram = cartridge->mbc != MBC_2 && !(cartridge->mbc == MBC_3 && cartridge->ram_select >= 0x08);
+    cartridge->ram_mapped = (cartridge->ram_enable && cartridge->nbr_ram_bank && plain_ram) ? cartridge->ram + RAM_BANK_SIZE * cartridge->current_ram_bank : NULL;
+}
 
-    
-    cartridge->rom = malloc(sizeof(uint8_t) * cartridge->rom_size);
-    if (!cartridge->rom) { fclose(file); fprintf(stderr, "Error malloc cartridge"); abort(); }
+//advance the clock registers by the host time elapsed since the last sync, unless halted
+static void rtc_sync(Cartridge* cartridge) {
+    time_t now = time(NULL);
+    time_t elapsed = now - cartridge->rtc_time;
+    cartridge->rtc_time = now;
+    if (elapsed <= 0 || (cartridge->rtc[RTC_DH] & 0x40)) { return; }
+
+    uint8_t* rtc = cartridge->rtc;
+    uint64_t total = rtc[RTC_S] + (uint64_t)elapsed;
+    rtc[RTC_S] = total % 60;
+    total = rtc[RTC_M] + total / 60;
+    rtc[RTC_M] = total % 60;
+    total = rtc[RTC_H] + total / 60;
+    rtc[RTC_H] = total % 24;
+    total = (((rtc[RTC_DH] & 0x1) << 8) | rtc[RTC_DL]) + total / 24;
+    if (total > 0x1FF) { rtc[RTC_DH] |= 0x80; } //day counter carry, stays set until written
+    rtc[RTC_DL] = total & 0xFF;
+    rtc[RTC_DH] = (rtc[RTC_DH] & 0xFE) | ((total >> 8) & 0x1);
+}
 
-    fread(cartridge->rom, 1, cartridge->rom_size, file);
-    fclose(file);
+void load_cartridge(Cartridge* cartridge,const char* filename, SaveMode save_mode, Arena* arena) {
+    if (!cartridge || !filename || !arena) { abort(); }
 
-    if (cartridge->rom_size < 0x150) { free(cartridge->rom); fprintf(stderr, "Error rom_size is too short"); abort(); }
+    cartridge->rom_image = rom_registry_acquire(filename); //no copy: the file is mapped once per process
+    if (!cartridge->rom_image) { abort(); }
+    cartridge->rom = cartridge->rom_image->data;
+    cartridge->rom_size = cartridge->rom_image->size;
 
     cartridge->mbc_type = cartridge->rom[0x147]; //get the MBC Type of the cartridge
-    if (cartridge->mbc_type > 0x3) { free(cartridge->rom); fprintf(stderr, "Error: MBC cartridge unsupported"); abort(); } //unsupported MBC type cartridge
+    bool has_ram = false;
+    bool has_battery = false;
+    cartridge->has_rtc = false;
+    switch (cartridge->mbc_type) {
+        case 0x00: { cartridge->mbc = MBC_NONE; break; }
+        case 0x08:
+        case 0x09: { cartridge->mbc = MBC_NONE; has_ram = true; has_battery = (cartridge->mbc_type == 0x09); break; }
+        case 0x01: { cartridge->mbc = MBC_1; break; }
+        case 0x02:
+        case 0x03: { cartridge->mbc = MBC_1; has_ram = true; has_battery = (cartridge->mbc_type == 0x03); break; }
+        case 0x05:
+        case 0x06: { cartridge->mbc = MBC_2; has_battery = (cartridge->mbc_type == 0x06); break; }
+        case 0x0F: { cartridge->mbc = MBC_3; cartridge->has_rtc = true; has_battery = true; break; }
+        case 0x10: { cartridge->mbc = MBC_3; cartridge->has_rtc = true; has_ram = true; has_battery = true; break; }
+        case 0x11: { cartridge->mbc = MBC_3; break; }
+        case 0x12:
+        case 0x13: { cartridge->mbc = MBC_3; has_ram = true; has_battery = (cartridge->mbc_type == 0x13); break; }
+        case 0x19:
+        case 0x1C: { cartridge->mbc = MBC_5; break; }
+        case 0x1A:
+        case 0x1B:
+        case 0x1D:
+        case 0x1E: { cartridge->mbc = MBC_5; has_ram = true; has_battery = (cartridge->mbc_type == 0x1B || cartridge->mbc_type == 0x1E); break; }
+        default: { rom_registry_release(cartridge->rom_image); fprintf(stderr, "Error: MBC cartridge unsupported"); abort(); } //unsupported MBC type cartridge
+    }
+
+    cartridge->nbr_ram_bank = (has_ram) ? rambank_number(cartridge->rom[0x149]) : 0;
+    cartridge->nbr_rom_bank = cartridge->rom_size / ROM_BANK_SIZE; //the registry sized the image from the header (0x148) and the file
 
-    cartridge->nbr_ram_bank = rambank_number(cartridge->rom[0x149]);
-    cartridge->nbr_rom_bank = rombank_number(cartridge->rom[0x148]);
     //default constructor
     cartridge->ram = NULL;
-    cartridge->ram_enable = false;
+    cartridge->ram_enable = (cartridge->mbc == MBC_NONE); //no register to enable it without MBC
     cartridge->ram_size = 0;
     cartridge->current_ram_bank = 0;
     cartridge->current_rom_bank = 1;
+    cartridge->rom0_bank = 0;
     cartridge->mode_flag = 0;
-
-    //allocate ram array if not noMBC but ram_enable still false
-    if (cartridge->mbc_type != 0) { //MBC1, etc.
-        cartridge->ram_size = cartridge->nbr_ram_bank * 0x2000; //ram size = ram bank number * 8KiB (size of 1 ram bank)
-        cartridge->ram = malloc(sizeof(uint8_t) * cartridge->ram_size);
-        if (!cartridge->ram) { free(cartridge->rom); fprintf(stderr, "Error ram size"); abort(); }
-        memset(cartridge->ram, 0, sizeof(uint8_t) * cartridge->ram_size);
+    cartridge->bank_low = 1;
+    cartridge->bank_high = 0;
+    cartridge->ram_select = 0;
+    cartridge->rtc_latch = 0xFF;
+    cartridge->rtc_time = time(NULL);
+    memset(cartridge->rtc, 0, sizeof(uint8_t) * RTC_COUNT);
+    memset(cartridge->rtc_latched, 0, sizeof(uint8_t) * RTC_COUNT);
+
+    if (cartridge->mbc == MBC_2) { cartridge->ram_size = MBC2_RAM_SIZE; }
+    else { cartridge->ram_size = cartridge->nbr_ram_bank * RAM_BANK_SIZE; } //ram size = ram bank number * 8KiB (size of 1 ram bank)
+    cartridge->has_save = false;
+    if (cartridge->ram_size && has_battery && save_mode != SAVE_NONE) {
+        cartridge->has_save = save_file_open(&cartridge->save, filename, cartridge->ram_size, save_mode);
+        if (cartridge->has_save) { cartridge->ram = cartridge->save.data; }
+        else { fprintf(stderr, "[WARNING]: no save file for %s, the external RAM will not be kept\n", filename); }
+    }
+    if (cartridge->ram_size && !cartridge->has_save) { cartridge->ram = arena_alloc(arena, sizeof(uint8_t) * cartridge->ram_size); } //zeroed
+
+    //the MBC is resolved once here, memory only calls through these pointers
+    cartridge->read = cartridge_read_banked;
+    switch (cartridge->mbc) {
+        case MBC_NONE: { cartridge->write = cartridge_write_nombc; break; }
+        case MBC_1: { cartridge->write = cartridge_write_mbc1; break; }
+        case MBC_2: { cartridge->read = cartridge_read_mbc2; cartridge->write = cartridge_write_mbc2; break; }
+        case MBC_3: { cartridge->read = cartridge_read_mbc3; cartridge->write = cartridge_write_mbc3; break; }
+        case MBC_5: { cartridge->write = cartridge_write_mbc5; break; }
+        default: { abort(); }
     }
+
+    cartridge_update_banks(cartridge);
 }
 
-void eject_cartridge(Cartridge* cartridge) {
+//false if the last writes to the external RAM could not be saved
+bool eject_cartridge(Cartridge* cartridge) {
     if (!cartridge) { abort(); }
 
-    if (cartridge->rom) { free(cartridge->rom); }
-    if (cartridge->ram) { free(cartridge->ram); }
+    if (cartridge->rom_image) { rom_registry_release(cartridge->rom_image); }
+    cartridge->rom_image = NULL;
+    cartridge->rom = NULL;
+    bool saved = true;
+    if (cartridge->has_save) { saved = save_file_close(&cartridge->save); } //flushes the last writes, the other RAM goes with the arena
+    if (!saved) { fprintf(stderr, "[ERROR]: the last writes to the external RAM could not be saved\n"); }
+    cartridge->has_save = false;
+    cartridge->ram = NULL;
+    cartridge->ram_mapped = NULL;
+    return saved;
 }
 
 uint8_t cartridge_read(Cartridge* cartridge, uint16_t address) {
     if (!cartridge) { abort(); }
 
-    if (cartridge->mbc_type == 0)
-        return cartridge_read_nombc(cartridge, address);
-    else
-        return cartridge_read_mbc1(cartridge, address);
-   return 0xFF;
+    return cartridge->read(cartridge, address);
 }
 
 void cartridge_write(Cartridge* cartridge, uint16_t address, uint8_t data) {
     if (!cartridge) { abort(); }
 
-    if (cartridge->mbc_type == 0)
-        cartridge_write_nombc(cartridge, address, data);
-    else
-        cartridge_write_mbc1(cartridge, address, data);
+    cartridge->write(cartridge, address, data);
 }
 
 
-uint8_t cartridge_read_nombc(Cartridge* cartridge, uint16_t address) {
+//ROM and plain external RAM through the bank pointers, shared by every MBC
+uint8_t cartridge_read_banked(Cartridge* cartridge, uint16_t address) {
     if (!cartridge || !cartridge->rom) { abort(); }
 
-    if (address >= 0xA000 && address <= 0xBFFF)
-        return 0xFF; //NO RAM in noMBC so return default value
-    
-    return cartridge->rom[address];
+    if (address <= 0x3FFF) { return cartridge->rom0[address]; }
+    if (address <= 0x7FFF) { return cartridge->romx[address - 0x4000]; }
+    if (address >= 0xA000 && address <= 0xBFFF && cartridge->ram_mapped) { return cartridge->ram_mapped[address - 0xA000]; }
+
+    return 0xFF; //disabled or no external RAM
+}
+
+//store to the mapped RAM bank, the save writer only learns which bank is dirty
+static inline void cartridge_ram_store(Cartridge* cartridge, uint16_t address, uint8_t data) {
+    if (cartridge->has_save) {
+        uint32_t offset = (cartridge->ram_mapped - cartridge->ram) + (address - 0xA000);
+        save_file_store(&cartridge->save, offset, cartridge->current_ram_bank, data);
+    }
+    else { cartridge->ram_mapped[address - 0xA000] = data; }
 }
 
 void cartridge_write_nombc(Cartridge* cartridge, uint16_t address, uint8_t data) {
-    return; //Read Only Memory, not modificition accepted and NO external RAM
+    if (!cartridge) { abort(); }
+
+    //Read Only Memory, not modificition accepted. External RAM only on 0x08/0x09 cartridges
+    if (address >= 0xA000 && address <= 0xBFFF && cartridge->ram_mapped) { cartridge_ram_store(cartridge, address, data); }
 }
 
 
-uint8_t cartridge_read_mbc1(Cartridge* cartridge, uint16_t address) {
-    if (!cartridge || !cartridge->rom) { abort(); }
+void cartridge_write_mbc1(Cartridge* cartridge, uint16_t address, uint8_t data) {
+    if (!cartridge) { abort(); }
 
-     if (address >= 0x0000 && address <= 0x3FFF) {
-        return cartridge->rom[address];
+    if (address >= 0xA000 && address <= 0xBFFF) {
+        if (cartridge->ram_mapped) { cartridge_ram_store(cartridge, address, data); }
+        return;
     }
 
-    if (address >= 0x4000 && address <= 0x7FFF) {
-        uint16_t address_into_bank = address - 0x4000;
-        uint32_t bank_offset = 0x4000 * cartridge->current_rom_bank;
+    if (address <= 0x1FFF) { cartridge->ram_enable = (data & 0x0F) == 0x0A; }
+    else if (address <= 0x3FFF) { cartridge->bank_low = (data & 0x1F) ? (data & 0x1F) : 1; } //0x20, 0x40 and 0x60 give 0x21, 0x41 and 0x61
+    else if (address <= 0x5FFF) { cartridge->bank_high = data & 0x3; } //upper bits of the ROM bank or RAM bank
+    else if (address <= 0x7FFF) { cartridge->mode_flag = data & 0x1; } //banking mode
+    cartridge_update_banks(cartridge);
+}
 
-        uint32_t address_in_rom = bank_offset + address_into_bank;
-        return cartridge->rom[address_in_rom];
-    }
+
+//512 x 4 bits of RAM inside the MBC, mirrored over 0xA000-0xBFFF, the upper nibble reads 1
+uint8_t cartridge_read_mbc2(Cartridge* cartridge, uint16_t address) {
+    if (!cartridge || !cartridge->rom) { abort(); }
 
     if (address >= 0xA000 && address <= 0xBFFF) {
-        uint16_t offset_into_ram = 0x2000 * cartridge->current_ram_bank;
-        uint16_t address_in_ram = (address - 0xA000) + offset_into_ram;
-        return cartridge->ram[address_in_ram];
+        if (!cartridge->ram_enable) { return 0xFF; }
+        return cartridge->ram[(address - 0xA000) & (MBC2_RAM_SIZE - 1)] | 0xF0;
     }
 
-    return 0xFF;
+    return cartridge_read_banked(cartridge, address);
 }
 
-void cartridge_write_mbc1(Cartridge* cartridge, uint16_t address, uint8_t data) {
+void cartridge_write_mbc2(Cartridge* cartridge, uint16_t address, uint8_t data) {
     if (!cartridge) { abort(); }
 
-     if (address >= 0x0000 && address <= 0x1FFF) {
-        cartridge->ram_enable = true;
+    if (address >= 0xA000 && address <= 0xBFFF) {
+        if (cartridge->ram_enable) {
+            uint32_t offset = (address - 0xA000) & (MBC2_RAM_SIZE - 1);
+            if (cartridge->has_save) { save_file_store(&cartridge->save, offset, 0, data & 0x0F); }
+            else { cartridge->ram[offset] = data & 0x0F; }
+        }
+        return;
     }
 
-    if (address >= 0x2000 && address <= 0x3FFF) {
-        if (data == 0x0) { cartridge->current_rom_bank = 0x1; }
-        if (data == 0x20) { cartridge->current_rom_bank = 0x21; return; }
-        if (data == 0x40) { cartridge->current_rom_bank = 0x41; return; }
-        if (data == 0x60) { cartridge->current_rom_bank = 0x61; return; }
-
-        uint16_t rom_bank_bits = data & 0x1F;
-        cartridge->current_rom_bank = rom_bank_bits;
+    if (address <= 0x3FFF) { //bit 8 of the address selects the register
+        if (address & 0x100) { cartridge->bank_low = (data & 0x0F) ? (data & 0x0F) : 1; }
+        else { cartridge->ram_enable = (data & 0x0F) == 0x0A; }
+        cartridge_update_banks(cartridge);
     }
+}
 
-    if (address >= 0x4000 && address <= 0x5FFF) {
-        printf("Unimplemented: Setting upper bits of ROM bank number");
-        fflush(stdout);
-    }
 
-    if (address >= 0x6000 && address <= 0x7FFF) {
-        printf("Unimplemented: Selecting ROM/RAM Mode");
-        fflush(stdout);
+//0xA000-0xBFFF maps a RAM bank or, for 0x08-0x0C in the RAM bank register, a latched RTC register
+uint8_t cartridge_read_mbc3(Cartridge* cartridge, uint16_t address) {
+    if (!cartridge || !cartridge->rom) { abort(); }
+
+    if (address >= 0xA000 && address <= 0xBFFF && cartridge->ram_select >= 0x08) {
+        if (!cartridge->ram_enable || !cartridge->has_rtc || cartridge->ram_select > 0x0C) { return 0xFF; }
+        return cartridge->rtc_latched[cartridge->ram_select - 0x08];
     }
 
+    return cartridge_read_banked(cartridge, address);
+}
+
+void cartridge_write_mbc3(Cartridge* cartridge, uint16_t address, uint8_t data) {
+    if (!cartridge) { abort(); }
+
     if (address >= 0xA000 && address <= 0xBFFF) {
-        if (!cartridge->ram_enable) { return; }
+        if (cartridge->ram_mapped) { cartridge_ram_store(cartridge, address, data); return; }
+        if (!cartridge->ram_enable || !cartridge->has_rtc || cartridge->ram_select < 0x08 || cartridge->ram_select > 0x0C) { return; }
+
+        static const uint8_t rtc_mask[RTC_COUNT] = { 0x3F, 0x3F, 0x1F, 0xFF, 0xC1 };
+        rtc_sync(cartridge); //the time before the write (or before the halt) is counted
+        cartridge->rtc[cartridge->ram_select - 0x08] = data & rtc_mask[cartridge->ram_select - 0x08];
+        return;
+    }
 
-        uint16_t offset_into_ram = 0x2000 * cartridge->current_ram_bank;
-        uint16_t address_in_ram = (address - 0xA000) + offset_into_ram;
-        cartridge->ram[address_in_ram] = data;
+    if (address <= 0x1FFF) { cartridge->ram_enable = (data & 0x0F) == 0x0A; } //RAM and RTC
+    else if (address <= 0x3FFF) { cartridge->bank_low = (data & 0x7F) ? (data & 0x7F) : 1; }
+    else if (address <= 0x5FFF) { cartridge->ram_select = data; }
+    else if (address <= 0x7FFF) {
+        if (cartridge->rtc_latch == 0x00 && data == 0x01 && cartridge->has_rtc) {
+            rtc_sync(cartridge);
+            memcpy(cartridge->rtc_latched, cartridge->rtc, sizeof(uint8_t) * RTC_COUNT);
+        }
+        cartridge->rtc_latch = data;
+        return;
     }
+    cartridge_update_banks(cartridge);
 }
 
+
+void cartridge_write_mbc5(Cartridge* cartridge, uint16_t address, uint8_t data) {
+    if (!cartridge) { abort(); }
+
+    if (address >= 0xA000 && address <= 0xBFFF) {
+        if (cartridge->ram_mapped) { cartridge_ram_store(cartridge, address, data); }
+        return;
+    }
+
+    if (address <= 0x1FFF) { cartridge->ram_enable = (data & 0x0F) == 0x0A; }
+    else if (address <= 0x2FFF) { cartridge->bank_low = data; } //bank 0 can be mapped at 0x4000
+    else if (address <= 0x3FFF) { cartridge->bank_high = data & 0x1; }
+    else if (address <= 0x5FFF) { cartridge->ram_select = data & 0x0F; }
+    cartridge_update_banks(cartridge);
+}
@@ -3,31 +3,87 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
+#include "rom_registry.h"
+#include "save_file.h"
+#include "arena.h"
 
+#define RAM_BANK_SIZE 0x2000
+#define MBC2_RAM_SIZE 0x200 //512 x 4 bits inside the MBC2
 
-typedef struct {
-    uint8_t* rom;
-    uint8_t* ram;
-    long rom_size; //size of rom array
+typedef enum {
+    MBC_NONE,
+    MBC_1,
+    MBC_2,
+    MBC_3,
+    MBC_5
+} MbcKind;
+
+typedef enum {
+    RTC_S,
+    RTC_M,
+    RTC_H,
+    RTC_DL,
+    RTC_DH, //bit 0: day bit 8, bit 6: halt, bit 7: day carry
+    RTC_COUNT
+} RtcRegister;
+
+struct Cartridge;
+typedef uint8_t (*CartridgeRead)(struct Cartridge* cartridge, uint16_t address);
+typedef void (*CartridgeWrite)(struct Cartridge* cartridge, uint16_t address, uint8_t data);
+
+typedef struct Cartridge {
+    const RomImage* rom_image; //shared with the other cartridges running the same file
+    const uint8_t* rom; //rom_image->data
+    uint8_t* ram; //from the arena of the instance, or the save file
+    long rom_size; //size of rom array, a power of two number of banks
     long ram_size; //size of ram array
-    uint8_t mbc_type; //mbc type noMBC, MBC1
-    uint8_t current_rom_bank;
+    uint8_t mbc_type; //cartridge type from the header (0x147)
+    MbcKind mbc;
+    uint16_t current_rom_bank; //bank at 0x4000-0x7FFF
+    uint16_t rom0_bank; //bank at 0x0000-0x3FFF, not 0 only in MBC1 mode 1
     uint8_t current_ram_bank;
     uint32_t nbr_rom_bank; //number of rom banks
     uint32_t nbr_ram_bank; //number of ram banks
     bool ram_enable; //handle external ram activation
     uint8_t mode_flag; //manage read for mbc1
+
+    //bank registers as written, the banks above are derived from them
+    uint8_t bank_low; //MBC1: 5 bits, MBC2/3: ROM bank, MBC5: 8 low bits
+    uint8_t bank_high; //MBC1: 2 bits, MBC5: ROM bank bit 8
+    uint8_t ram_select; //MBC3: RAM bank 0-3 or RTC register 0x08-0x0C, MBC5: RAM bank
+
+    //host addresses of the current banks, only changed by the bank register writes
+    const uint8_t* rom0; //0x0000-0x3FFF
+    const uint8_t* romx; //0x4000-0x7FFF
+    uint8_t* ram_mapped; //0xA000-0xBFFF, NULL if the external RAM is disabled, absent or not plain RAM (MBC2, RTC)
+
+    CartridgeRead read; //chosen by load_cartridge for the MBC
+    CartridgeWrite write;
+
+    bool has_rtc;
+    uint8_t rtc[RTC_COUNT];
+    uint8_t rtc_latched[RTC_COUNT]; //what the game reads, copied from rtc by the latch sequence 0x00 then 0x01
+    uint8_t rtc_latch; //last write to 0x6000-0x7FFF
+    time_t rtc_time; //host time rtc is up to date at
+
+    bool has_save; //battery backed: ram is save.data, written back to the .sav file in the background
+    SaveFile save;
 } Cartridge;
 
-void load_cartridge(Cartridge* cartridge,const char* filename);
-void eject_cartridge(Cartridge* cartridge);
+void load_cartridge(Cartridge* cartridge,const char* filename, SaveMode save_mode, Arena* arena);
+bool eject_cartridge(Cartridge* cartridge);
 
 uint8_t cartridge_read(Cartridge* cartridge, uint16_t address);
 void cartridge_write(Cartridge* cartridge, uint16_t address, uint8_t data);
 
-uint8_t cartridge_read_nombc(Cartridge* cartridge, uint16_t address);
-uint8_t cartridge_read_mbc1(Cartridge* cartridge, uint16_t address);
+uint8_t cartridge_read_banked(Cartridge* cartridge, uint16_t address);
+uint8_t cartridge_read_mbc2(Cartridge* cartridge, uint16_t address);
+uint8_t cartridge_read_mbc3(Cartridge* cartridge, uint16_t address);
 void cartridge_write_nombc(Cartridge* cartridge, uint16_t address, uint8_t data);
 void cartridge_write_mbc1(Cartridge* cartridge, uint16_t address, uint8_t data);
+void cartridge_write_mbc2(Cartridge* cartridge, uint16_t address, uint8_t data);
+void cartridge_write_mbc3(Cartridge* cartridge, uint16_t address, uint8_t data);
+void cartridge_write_mbc5(Cartridge* cartridge, uint16_t address, uint8_t data);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,108 @@
+#include "rom_registry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ROM_HEADER_END 0x150
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static RomImage* registry = NULL;
+
+//banks the image must hold: the header ROM size and the file, rounded up to a power of two
+static size_t rom_image_size(const uint8_t* header, off_t file_size)
+{
+    size_t size = 2 * ROM_BANK_SIZE;
+    if (header[0x148] <= 0x8) { size = (size_t)(2 * ROM_BANK_SIZE) << header[0x148]; }
+    while (size < (size_t)file_size) { size *= 2; }
+    return size;
+}
+
+static RomImage* rom_image_load(int fd, const struct stat* st)
+{
+    if (st->st_size < ROM_HEADER_END) { fprintf(stderr, "Error rom_size is too short"); return NULL; }
+
+    RomImage* image = malloc(sizeof(RomImage));
+    if (!image) { fprintf(stderr, "Error malloc cartridge"); return NULL; }
+
+    uint8_t* data = mmap(NULL, st->st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) { free(image); fprintf(stderr, "Error: mmap cartridge"); return NULL; }
+
+    image->size = rom_image_size(data, st->st_size);
+    image->mapped = (image->size == (size_t)st->st_size);
+    if (image->mapped) {
+        madvise(data, image->size, MADV_WILLNEED); //read it now, the pages are shared with the other mappings of the file
+        madvise(data, image->size, MADV_RANDOM); //bank switches jump around, no readahead later
+        image->data = data;
+    }
+    else { //truncated rom: the banks past the end of the file would fault, use a padded copy shared the same way
+        uint8_t* copy = malloc(image->size);
+        if (!copy) { munmap(data, st->st_size); free(image); fprintf(stderr, "Error malloc cartridge"); return NULL; }
+        memcpy(copy, data, st->st_size);
+        memset(copy + st->st_size, 0xFF, image->size - st->st_size);
+        munmap(data, st->st_size);
+        image->data = copy;
+    }
+
+    image->dev = st->st_dev;
+    image->ino = st->st_ino;
+    image->file_size = st->st_size;
+    image->mtime = st->st_mtim;
+    image->refs = 0;
+    return image;
+}
+
+//the image of filename, mapped on first use and shared by reference count. NULL if it can not be loaded
+const RomImage* rom_registry_acquire(const char* filename)
+{
+    if (!filename) { abort(); }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) { fprintf(stderr, "Error: Cartridge not open"); return NULL; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); fprintf(stderr, "Error: Cartridge not open"); return NULL; }
+
+    pthread_mutex_lock(&registry_lock);
+
+    RomImage* image = registry;
+    while (image && !(image->dev == st.st_dev && image->ino == st.st_ino && image->file_size == st.st_size &&
+                       image->mtime.tv_sec == st.st_mtim.tv_sec && image->mtime.tv_nsec == st.st_mtim.tv_nsec)) {
+        image = image->next;
+    }
+    if (!image) {
+        image = rom_image_load(fd, &st);
+        if (image) { image->next = registry; registry = image; }
+    }
+    if (image) { image->refs++; }
+
+    pthread_mutex_unlock(&registry_lock);
+    close(fd); //the mapping stays valid without the descriptor
+    return image;
+}
+
+void rom_registry_release(const RomImage* image)
+{
+    if (!image) { abort(); }
+
+    pthread_mutex_lock(&registry_lock);
+
+    RomImage** prev = &registry;
+    while (*prev && *prev != image) { prev = &(*prev)->next; }
+    if (!*prev) { pthread_mutex_unlock(&registry_lock); fprintf(stderr, "[ERROR]: release of a ROM image not in the registry"); abort(); }
+
+    RomImage* entry = *prev;
+    entry->refs--;
+    if (entry->refs == 0) {
+        *prev = entry->next;
+        if (entry->mapped) { munmap((void*)entry->data, entry->size); }
+        else { free((void*)entry->data); }
+        free(entry);
+    }
+
+    pthread_mutex_unlock(&registry_lock);
+}
@@ -0,0 +1,30 @@
+#ifndef __ROM_REGISTRY_H__
+#define __ROM_REGISTRY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define ROM_BANK_SIZE 0x4000
+
+//a ROM file loaded once per process and shared read-only by every cartridge running it
+typedef struct RomImage {
+    dev_t dev; //identity of the file
+    ino_t ino;
+    off_t file_size;
+    struct timespec mtime;
+
+    const uint8_t* data;
+    size_t size; //a power of two number of 16 KiB banks, at least what the header declares
+    bool mapped; //mmap of the file, else a heap copy padded with 0xFF (file shorter than size)
+    uint32_t refs;
+
+    struct RomImage* next;
+} RomImage;
+
+const RomImage* rom_registry_acquire(const char* filename);
+void rom_registry_release(const RomImage* image);
+
+#endif
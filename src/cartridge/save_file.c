@@ -0,0 +1,248 @@
+#include "save_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static bool writer_running = false;
+static bool writer_stop = false;
+static SaveFile* saves = NULL;
+
+//<rom without extension>.sav
+static char* save_path(const char* rom_filename, const char* suffix)
+{
+    size_t length = strlen(rom_filename);
+    const char* dot = strrchr(rom_filename, '.');
+    const char* slash = strrchr(rom_filename, '/');
+    if (dot && (!slash || dot > slash)) { length = dot - rom_filename; }
+
+    char* path = malloc(length + strlen(suffix) + 1);
+    if (!path) { return NULL; }
+    memcpy(path, rom_filename, length);
+    strcpy(path + length, suffix);
+    return path;
+}
+
+static bool read_file(int fd, uint8_t* data, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n < 0) { return false; }
+        if (n == 0) { break; } //shorter or new save: the rest stays cleared
+        done += n;
+    }
+    return true;
+}
+
+//copy the banks to the image, false if a store of the emulation thread ran through the copy or came after the last pass:
+//the image may be torn, the banks are copied again once the writes stop
+static bool save_file_snapshot(SaveFile* save, uint32_t banks)
+{
+    uint32_t sequence = __atomic_load_n(&save->sequence, __ATOMIC_ACQUIRE);
+    if ((sequence & 1) || __atomic_load_n(&save->dirty, __ATOMIC_RELAXED)) { return false; }
+
+    for (uint32_t bank = 0; bank < 32; bank++) {
+        if (!(banks & (1u << bank)) || bank * SAVE_BANK_SIZE >= save->size) { continue; }
+        size_t length = save->size - bank * SAVE_BANK_SIZE;
+        if (length > SAVE_BANK_SIZE) { length = SAVE_BANK_SIZE; }
+        memcpy(save->image + bank * SAVE_BANK_SIZE, save->data + bank * SAVE_BANK_SIZE, length);
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&save->sequence, __ATOMIC_RELAXED) == sequence;
+}
+
+//write the image to a temporary of this instance, sync and lock it, then rename it over path: the lock moves with the file
+static bool save_file_commit(SaveFile* save)
+{
+    char* tmp_path = strdup(save->tmp_path);
+    if (!tmp_path) { return false; }
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) { free(tmp_path); return false; }
+
+    bool ok = fchmod(fd, 0644) == 0 && flock(fd, LOCK_EX | LOCK_NB) == 0;
+    size_t done = 0;
+    while (ok && done < save->size) {
+        ssize_t n = write(fd, save->image + done, save->size - done);
+        if (n < 0 && errno == EINTR) { continue; }
+        if (n <= 0) { ok = false; }
+        else { done += n; }
+    }
+    ok = ok && fsync(fd) == 0 && rename(tmp_path, save->path) == 0;
+    if (!ok) {
+        int error = errno;
+        close(fd);
+        unlink(tmp_path);
+        free(tmp_path);
+        errno = error;
+        return false;
+    }
+    free(tmp_path);
+
+    close(save->fd); //the replaced .sav, nothing opens it anymore
+    save->fd = fd;
+
+    char* dir_name = strdup(save->path); //make the rename itself durable
+    if (dir_name) {
+        int dir = open(dirname(dir_name), O_RDONLY | O_DIRECTORY);
+        if (dir >= 0) { fsync(dir); close(dir); }
+        free(dir_name);
+    }
+    return true;
+}
+
+//returns the banks left to flush: the ones copied while the emulation thread wrote them, or whose write failed
+static uint32_t save_file_flush(SaveFile* save, uint32_t banks)
+{
+    uint32_t failed = 0;
+    if (save->mode == SAVE_MMAP) {
+        for (uint32_t bank = 0; bank < 32; bank++) {
+            if (!(banks & (1u << bank)) || bank * SAVE_BANK_SIZE >= save->size) { continue; }
+            size_t length = save->size - bank * SAVE_BANK_SIZE;
+            if (length > SAVE_BANK_SIZE) { length = SAVE_BANK_SIZE; }
+            if (msync(save->data + bank * SAVE_BANK_SIZE, length, MS_SYNC) != 0) { failed |= 1u << bank; }
+        }
+    }
+    else if (save->mode == SAVE_COMMIT) {
+        if (!save_file_snapshot(save, banks)) { return banks; }
+        if (!save_file_commit(save)) { failed = banks; }
+    }
+
+    if (!failed) {
+        if (save->failures) { fprintf(stderr, "[WARNING]: flush of %s succeeded after %u failures\n", save->path, save->failures); }
+        save->failures = 0;
+        return 0;
+    }
+    if (save->failures++ % SAVE_WARN_FAILURES == 0) { fprintf(stderr, "[WARNING]: flush of %s failed, retried every %d ms: %s\n", save->path, SAVE_FLUSH_INTERVAL_MS, strerror(errno)); }
+    return failed;
+}
+
+//flush the saves whose writes stopped for one interval: a game writes its save in a burst
+static void* writer_main(void* arg)
+{
+    pthread_mutex_lock(&writer_lock);
+    while (!writer_stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += SAVE_FLUSH_INTERVAL_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&writer_wake, &writer_lock, &deadline);
+
+        for (SaveFile* save = saves; save; save = save->next) {
+            uint32_t dirty = __atomic_exchange_n(&save->dirty, 0, __ATOMIC_RELAXED);
+            if (dirty) { save->pending |= dirty; continue; }
+            if (save->pending) { save->pending = save_file_flush(save, save->pending); }
+        }
+    }
+    pthread_mutex_unlock(&writer_lock);
+    return NULL;
+}
+
+//map or read <rom>.sav as size bytes of external RAM and register it with the writer. false if the file can not be used.
+//An other instance holding the .sav leaves this one a private copy of it, never written back
+bool save_file_open(SaveFile* save, const char* rom_filename, size_t size, SaveMode mode)
+{
+    if (!save || !rom_filename || mode == SAVE_NONE || size == 0) { abort(); }
+
+    save->mode = mode;
+    save->size = size;
+    save->dirty = 0;
+    save->pending = 0;
+    save->failures = 0;
+    save->sequence = 0;
+    save->data = NULL;
+    save->image = NULL;
+    save->path = save_path(rom_filename, ".sav");
+    save->tmp_path = save_path(rom_filename, ".sav.XXXXXX");
+    if (!save->path || !save->tmp_path) { free(save->path); free(save->tmp_path); return false; }
+
+    save->fd = open(save->path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (save->fd < 0 || fstat(save->fd, &st) != 0) {
+        if (save->fd >= 0) { close(save->fd); }
+        free(save->path); free(save->tmp_path);
+        return false;
+    }
+    if (flock(save->fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "[WARNING]: %s is used by an other instance, this one keeps its external RAM private\n", save->path);
+        save->mode = SAVE_NONE;
+    }
+
+    if (save->mode == SAVE_MMAP) {
+        uint8_t* data = MAP_FAILED;
+        if (st.st_size >= (off_t)size || ftruncate(save->fd, size) == 0)
+            data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, save->fd, 0);
+        if (data == MAP_FAILED) { close(save->fd); free(save->path); free(save->tmp_path); return false; }
+        save->data = data;
+    }
+    else {
+        save->data = calloc(size, sizeof(uint8_t));
+        if (!save->data || !read_file(save->fd, save->data, size)) {
+            free(save->data); close(save->fd); free(save->path); free(save->tmp_path);
+            return false;
+        }
+    }
+    if (save->mode == SAVE_NONE) { close(save->fd); save->fd = -1; return true; } //nothing for the writer
+    if (save->mode == SAVE_COMMIT) {
+        save->image = malloc(size);
+        if (!save->image) { free(save->data); close(save->fd); free(save->path); free(save->tmp_path); return false; }
+        memcpy(save->image, save->data, size);
+    }
+
+    pthread_mutex_lock(&writer_lock);
+    save->next = saves;
+    saves = save;
+    if (!writer_running) {
+        writer_stop = false;
+        writer_running = pthread_create(&writer_thread, NULL, writer_main, NULL) == 0;
+        if (!writer_running) { fprintf(stderr, "[WARNING]: no save writer thread, saves are written at exit only\n"); }
+    }
+    pthread_mutex_unlock(&writer_lock);
+    return true;
+}
+
+//last flush of what the writer did not write yet, then release the RAM. false if some of it could not be written
+bool save_file_close(SaveFile* save)
+{
+    if (!save) { abort(); }
+
+    pthread_mutex_lock(&writer_lock);
+    SaveFile** prev = &saves;
+    while (*prev && *prev != save) { prev = &(*prev)->next; }
+    if (*prev) { *prev = save->next; }
+
+    uint32_t banks = save->pending | __atomic_exchange_n(&save->dirty, 0, __ATOMIC_RELAXED);
+    if (banks) { banks = save_file_flush(save, banks); } //the emulation thread is stopped, no copy is torn
+
+    bool stop = writer_running && !saves;
+    if (stop) { writer_stop = true; writer_running = false; pthread_cond_signal(&writer_wake); }
+    pthread_mutex_unlock(&writer_lock);
+    if (stop) { pthread_join(writer_thread, NULL); }
+
+    if (save->mode == SAVE_MMAP) { munmap(save->data, save->size); }
+    else { free(save->data); }
+    free(save->image);
+    if (save->fd >= 0) { close(save->fd); } //releases the lock
+    free(save->path);
+    free(save->tmp_path);
+    save->data = NULL;
+    save->image = NULL;
+    save->path = NULL;
+    save->tmp_path = NULL;
+    save->fd = -1;
+    return banks == 0;
+}
@@ -0,0 +1,58 @@
+#ifndef __SAVE_FILE_H__
+#define __SAVE_FILE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SAVE_BANK_SIZE 0x2000 //dirty tracking granularity, one external RAM bank
+#define SAVE_FLUSH_INTERVAL_MS 500
+#define SAVE_WARN_FAILURES 120 //a flush failing on every pass is reported once a minute
+
+typedef enum {
+    SAVE_NONE, //external RAM is lost at exit
+    SAVE_MMAP, //the .sav file is mapped as external RAM, dirty banks are msync'ed
+    SAVE_COMMIT //private copy, written whole to a .sav.XXXXXX temporary then renamed over .sav: a crash leaves the old or the new save
+} SaveMode;
+
+//battery backed external RAM, flushed by a writer thread shared by every save of the process.
+//The instance holding the flock of the .sav owns it, the others run on a private copy of it (mode SAVE_NONE)
+typedef struct SaveFile {
+    SaveMode mode;
+    char* path;
+    char* tmp_path; //mkstemp template of the temporary files, next to path
+    int fd; //.sav opened and flock'ed, -1 for a private copy
+    uint8_t* data; //the external RAM
+    uint8_t* image; //SAVE_COMMIT: copy of data taken by the writer between two stores, the bytes it commits
+    size_t size;
+    uint32_t sequence; //odd while the emulation thread stores to data, a copy between two equal even values is not torn
+
+    uint32_t dirty; //banks written since the writer last looked, set with an atomic OR by the emulation thread
+    uint32_t pending; //banks the writer saw dirty, flushed once a pass finds no new write, kept until a flush succeeds
+    uint32_t failures; //flushes failed in a row
+
+    struct SaveFile* next;
+} SaveFile;
+
+bool save_file_open(SaveFile* save, const char* rom_filename, size_t size, SaveMode mode);
+bool save_file_close(SaveFile* save);
+
+//called on every write to the external RAM: no lock, no syscall
+static inline void save_file_mark_dirty(SaveFile* save, uint32_t bank)
+{
+    uint32_t mask = 1u << bank;
+    if (!(__atomic_load_n(&save->dirty, __ATOMIC_RELAXED) & mask)) { __atomic_fetch_or(&save->dirty, mask, __ATOMIC_RELAXED); } //locked only on the first write of a period
+}
+
+//store data at offset of the external RAM of bank, the writer retries a copy this store ran through
+static inline void save_file_store(SaveFile* save, uint32_t offset, uint32_t bank, uint8_t data)
+{
+    uint32_t sequence = __atomic_load_n(&save->sequence, __ATOMIC_RELAXED); //only this thread changes it
+    __atomic_store_n(&save->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    save->data[offset] = data;
+    save_file_mark_dirty(save, bank);
+    __atomic_store_n(&save->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+#endif
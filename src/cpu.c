@@ -1,7 +1,10 @@
 #include "cpu.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cpu_instr.h"
+#include "block_cache.h"
+#include "jit.h"
 
 void cpu_init(Cpu* cpu, Memory* memory)
 {
@@ -13,6 +16,9 @@ void cpu_init(Cpu* cpu, Memory* memory)
     if (!memory) { fprintf(stderr, "[ERROR] : BUS NOT LINKED TO THE CPU"); abort();}
 
     cpu->bus = memory;
+    cpu->scheduler = NULL;
+    cpu->block_cache = NULL;
+    cpu->jit = NULL;
     cpu->PC = 0x100;
     cpu->SP = 0xFFFE;
 
@@ -25,10 +31,46 @@ void cpu_init(Cpu* cpu, Memory* memory)
     cpu->HL.r8.lo = 0x4D; //reg L
     cpu->HL.r8.hi = 0x01; //reg H
 
+    cpu->r8[0] = &cpu->BC.r8.hi;
+    cpu->r8[1] = &cpu->BC.r8.lo;
+    cpu->r8[2] = &cpu->DE.r8.hi;
+    cpu->r8[3] = &cpu->DE.r8.lo;
+    cpu->r8[4] = &cpu->HL.r8.hi;
+    cpu->r8[5] = &cpu->HL.r8.lo;
+    cpu->r8[6] = NULL;
+    cpu->r8[7] = &cpu->AF.r8.hi;
+
+    cpu->r16[0] = &cpu->BC.r16;
+    cpu->r16[1] = &cpu->DE.r16;
+    cpu->r16[2] = &cpu->HL.r16;
+    cpu->r16[3] = &cpu->SP;
+
+    cpu->r16_stack[0] = &cpu->BC.r16;
+    cpu->r16_stack[1] = &cpu->DE.r16;
+    cpu->r16_stack[2] = &cpu->HL.r16;
+    cpu->r16_stack[3] = &cpu->AF.r16;
+
     cpu->IME = true;
     cpu->is_HALT = false;
     cpu->ei_delay = 0;
     cpu->di_delay = 0;
+    cpu->flag_op = FLAGS_SYNCED;
+    memset(&cpu->idle, 0, sizeof(IdleLoop));
+}
+
+//registers at power on, for the boot ROM to run from 0x0000. cpu_init leaves the state at its end
+void cpu_power_on(Cpu* cpu)
+{
+    if (!cpu) { abort(); }
+
+    cpu->PC = 0x0000;
+    cpu->SP = 0x0000;
+    cpu->AF.r16 = 0x0000;
+    cpu->BC.r16 = 0x0000;
+    cpu->DE.r16 = 0x0000;
+    cpu->HL.r16 = 0x0000;
+    cpu->IME = false;
+    cpu->flag_op = FLAGS_SYNCED;
 }
 
 void cpu_setFlag(Cpu* cpu, Flag flag)
@@ -36,6 +78,7 @@ void cpu_setFlag(Cpu* cpu, Flag flag)
     if (!cpu)
         abort();
     
+    cpu_syncFlags(cpu);
     cpu->AF.r8.lo |= flag;
 }
 
@@ -44,6 +87,7 @@ void cpu_clearFlag(Cpu* cpu, Flag flag)
     if (!cpu)
         abort();
     
+    cpu_syncFlags(cpu);
     cpu->AF.r8.lo &= (~flag);
 }
 
@@ -63,9 +107,58 @@ uint8_t cpu_getFlag(Cpu* cpu, Flag flag)
     if (!cpu)
         abort();
     
+    if (cpu->flag_op != FLAGS_SYNCED) {
+        if (flag == Z_FLAG) { return cpu->flag_res == 0; } //every deferred operation sets Z from its result
+        cpu_syncFlags(cpu);
+    }
     return (cpu->AF.r8.lo & flag) ? 1 : 0;
 }
 
+//compute F from the deferred operation, needed before anything reads or partially writes AF.r8.lo
+void cpu_syncFlags(Cpu* cpu)
+{
+    if (!cpu)
+        abort();
+
+    uint8_t a = cpu->flag_a;
+    uint8_t b = cpu->flag_b;
+    uint8_t c = cpu->flag_carry;
+    uint8_t f = (cpu->flag_res == 0) ? Z_FLAG : 0;
+
+    switch (cpu->flag_op) {
+        case FLAGS_SYNCED: return;
+        case FLAGS_ADD: {
+            if (((a & 0xf) + (b & 0xf) + c) > 0xf) { f |= H_FLAG; }
+            if ((a + b + c) > 0xff) { f |= C_FLAG; }
+            break;
+        }
+        case FLAGS_SUB: {
+            f |= N_FLAG;
+            if ((a & 0xf) < ((b & 0xf) + c)) { f |= H_FLAG; }
+            if (a < (b + c)) { f |= C_FLAG; }
+            break;
+        }
+        case FLAGS_AND: { f |= H_FLAG; break; }
+        case FLAGS_LOGIC: { break; }
+        case FLAGS_INC: {
+            if ((a & 0xf) == 0xf) { f |= H_FLAG; }
+            f |= cpu->AF.r8.lo & C_FLAG;
+            break;
+        }
+        case FLAGS_DEC: {
+            f |= N_FLAG;
+            if ((a & 0xf) == 0) { f |= H_FLAG; }
+            f |= cpu->AF.r8.lo & C_FLAG;
+            break;
+        }
+        case FLAGS_SHIFT: { if (c) { f |= C_FLAG; } break; }
+        case FLAGS_BIT: { f |= H_FLAG | (cpu->AF.r8.lo & C_FLAG); break; }
+    }
+
+    cpu->AF.r8.lo = f;
+    cpu->flag_op = FLAGS_SYNCED;
+}
+
 //like bus_read8 but read data from PC and increment it
 uint8_t cpu_fetch_byte_pc(Cpu* cpu)
 {
@@ -112,23 +205,321 @@ void cpu_update_ime(Cpu* cpu) {
     }
 }
 
-uint32_t cpu_ticks(Cpu* cpu)
+//cycles before the next scheduled event (the only things able to raise IF outside the cpu), capped to IDLE_MAX_TICKS
+static uint32_t cpu_cycles_to_event(Cpu* cpu)
 {
-    if (!cpu)
-        abort();
+    if (!cpu->scheduler || cpu->scheduler->next <= cpu->scheduler->now) { return 4; }
+
+    uint64_t cycles = cpu->scheduler->next - cpu->scheduler->now;
+    return (cycles > IDLE_MAX_TICKS) ? IDLE_MAX_TICKS : cycles;
+}
+
+//the halted cpu sleeps up to the next event at once, rounded to whole M-cycles
+static uint32_t cpu_halt_ticks(Cpu* cpu)
+{
+    return (cpu_cycles_to_event(cpu) + 3) & ~3u;
+}
+
+/********************************   IDLE LOOP DETECTION *******************************************/
+
+static void idle_loop_save(IdleLoop* idle, Cpu* cpu, const Block* block)
+{
+    idle->block = block;
+    idle->cycles = 0;
+    idle->AF = cpu->AF;
+    idle->BC = cpu->BC;
+    idle->DE = cpu->DE;
+    idle->HL = cpu->HL;
+    idle->SP = cpu->SP;
+    idle->flag_op = cpu->flag_op;
+    idle->flag_a = cpu->flag_a;
+    idle->flag_b = cpu->flag_b;
+    idle->flag_carry = cpu->flag_carry;
+    idle->flag_res = cpu->flag_res;
+    idle->IME = cpu->IME;
+    idle->interrupt_requested = cpu->bus->interrupt_requested;
+    idle->buttons = cpu->bus->joypad->buttons; //P1 is folded from them, its select bits change by writes
+    idle->writes = cpu->bus->writes;
+    idle->clock_reads = cpu->bus->clock_reads;
+    idle->ly_reads = cpu->bus->ly_reads;
+    idle->stat_reads = cpu->bus->stat_reads;
+    idle->start = (cpu->scheduler) ? cpu->scheduler->now : 0;
+}
+
+//nothing the iteration could read or write changed: the next ones will all run the same way, up to the next
+//LY/STAT change if it read them
+static bool idle_loop_same_state(IdleLoop* idle, Cpu* cpu)
+{
+    return idle->AF.r16 == cpu->AF.r16 && idle->BC.r16 == cpu->BC.r16 && idle->DE.r16 == cpu->DE.r16 &&
+           idle->HL.r16 == cpu->HL.r16 && idle->SP == cpu->SP &&
+           idle->flag_op == cpu->flag_op && idle->flag_a == cpu->flag_a && idle->flag_b == cpu->flag_b &&
+           idle->flag_carry == cpu->flag_carry && idle->flag_res == cpu->flag_res && idle->IME == cpu->IME &&
+           idle->interrupt_requested == cpu->bus->interrupt_requested && idle->buttons == cpu->bus->joypad->buttons &&
+           idle->writes == cpu->bus->writes && idle->clock_reads == cpu->bus->clock_reads;
+}
+
+//called at the start of a self-looping block: skip whole iterations up to the next event once one of them
+//went from a state back to the same state, 0 to run the block
+static uint32_t cpu_idle_skip(Cpu* cpu, const Block* block)
+{
+    IdleLoop* idle = &cpu->idle;
+
+    if (cpu->ei_delay || cpu->di_delay) { idle->block = NULL; return 0; }
+
+    if (idle->block == block && idle->cycles && idle_loop_same_state(idle, cpu)) {
+        uint32_t cycles = cpu_cycles_to_event(cpu);
+        bool stat = idle->stat_reads != cpu->bus->stat_reads;
+        if ((stat || idle->ly_reads != cpu->bus->ly_reads) && cpu->scheduler) { //LY/STAT polling: the iteration read them before any change
+            uint64_t now = cpu->scheduler->now;
+            uint64_t change = ppu_next_change(cpu->bus->ppu, idle->start, stat);
+            if (change <= now) { cycles = 0; } //changed during the iteration, the next one may read something else
+            else if (change - now < cycles) { cycles = change - now; }
+        }
+        uint32_t iterations = cycles / idle->cycles;
+        if (iterations) {
+            idle->skips++;
+            idle->skipped_cycles += (uint64_t)iterations * idle->cycles;
+            return iterations * idle->cycles;
+        }
+    }
+
+    idle_loop_save(idle, cpu, block);
+    return 0;
+}
+
+/************************************************************************************************************************ */
+
+//one instruction, interrupt dispatch or HALT/idle loop sleep, returns its cycles
+static inline uint32_t cpu_step(Cpu* cpu)
+{
+    if (cpu->ei_delay | cpu->di_delay | cpu->bus->interrupt_pending) { //IME changing or an interrupt pending
+        cpu_update_ime(cpu);
+        uint32_t ticks = handle_interrupts(cpu);
+        if (ticks) { return ticks; }
+    }
 
-    cpu_update_ime(cpu);
-    
-    uint32_t ticks = handle_interrupts(cpu);
-    switch (ticks) {case 0 : break; default: return ticks;}
-        
     if (cpu->is_HALT == true) {
-        return 4;
+        return cpu_halt_ticks(cpu);
+    }
+
+    if (cpu->block_cache) {
+        const DecodedInstr* instr = block_cache_fetch(cpu->block_cache, cpu->PC);
+        if (instr) {
+            BlockCache* cache = cpu->block_cache;
+            Block* block = cache->current;
+            uint32_t ticks = 0;
+
+            if (cache->index == 1 && block->self_loop) {
+                ticks = cpu_idle_skip(cpu, block);
+                if (ticks) { cache->index = 0; return ticks; } //still at the start of the loop
+            }
+
+            if (cpu->jit && cache->index == 1 && !cpu->ei_delay && !cpu->di_delay) { //at the start of a block
+                ticks = jit_run_block(cpu->jit, cpu, block);
+                if (ticks && cache->current) { cache->index = cache->current->count; } //chain from its end
+            }
+            if (!ticks) {
+                cpu->PC += instr->length;
+                ticks = instr->handler(cpu, instr->opcode, instr->operand);
+            }
+
+            if (cpu->idle.block) { //count the iteration, or stop watching once it left the loop
+                if (cpu->idle.block == block) { cpu->idle.cycles += ticks; }
+                else { cpu->idle.block = NULL; }
+            }
+            return ticks;
+        }
     }
 
     uint8_t opcode = cpu_fetch_byte_pc(cpu);
     return cpu_execute_instruction(cpu, opcode);
 }
+
+uint32_t cpu_ticks(Cpu* cpu)
+{
+    if (!cpu)
+        abort();
+
+    return cpu_step(cpu);
+}
+
+/********************************   REGISTERS IN LOCALS *******************************************/
+//cpu_run_cached keeps the guest registers in the locals BC, DE, HL, SP, A and PC, F stays in the Cpu struct with the
+//lazy flags it is computed from. The macros take the r8 or r16 operand field, a constant in every use that the
+//compiler folds to the local
+
+#define R16(r) (((r) == 0) ? BC : ((r) == 1) ? DE : ((r) == 2) ? HL : SP)
+#define R16_SET(r, value) do { \
+        uint16_t r16_ = (value); \
+        if ((r) == 0) { BC = r16_; } else if ((r) == 1) { DE = r16_; } else if ((r) == 2) { HL = r16_; } else { SP = r16_; } \
+    } while (0)
+#define R8(r) ((uint8_t)(((r) == 7) ? A : ((r) & 1) ? R16((r) >> 1) : R16((r) >> 1) >> 8))
+#define R8_SET(r, value) do { \
+        uint8_t r8_ = (value); \
+        if ((r) == 7) { A = r8_; } \
+        else if ((r) & 1) { R16_SET((r) >> 1, (R16((r) >> 1) & 0xFF00) | r8_); } \
+        else { R16_SET((r) >> 1, (R16((r) >> 1) & 0x00FF) | (r8_ << 8)); } \
+    } while (0)
+
+#define CPU_REGS_LOAD(cpu) do { \
+        BC = (cpu)->BC.r16; DE = (cpu)->DE.r16; HL = (cpu)->HL.r16; SP = (cpu)->SP; A = (cpu)->AF.r8.hi; PC = (cpu)->PC; \
+    } while (0)
+#define CPU_REGS_STORE(cpu) do { \
+        (cpu)->BC.r16 = BC; (cpu)->DE.r16 = DE; (cpu)->HL.r16 = HL; (cpu)->SP = SP; (cpu)->AF.r8.hi = A; (cpu)->PC = PC; \
+    } while (0)
+
+static bool cpu_condition(Cpu* cpu, uint8_t opcode);
+
+//8 bits ALU operation op (bits 3-5 of the opcode) on A, returns the new A. op is a constant in every case using it
+static inline __attribute__((always_inline)) uint8_t cpu_alu(Cpu* cpu, uint8_t op, uint8_t a, uint8_t data)
+{
+    uint8_t c, res;
+    switch (op) {
+        case 0: { res = a + data; cpu_deferFlags(cpu, FLAGS_ADD, a, data, 0, res); return res; } //ADD
+        case 1: { c = cpu_getFlag(cpu, C_FLAG); res = a + data + c; cpu_deferFlags(cpu, FLAGS_ADD, a, data, c, res); return res; } //ADC
+        case 2: { res = a - data; cpu_deferFlags(cpu, FLAGS_SUB, a, data, 0, res); return res; } //SUB
+        case 3: { c = cpu_getFlag(cpu, C_FLAG); res = a - data - c; cpu_deferFlags(cpu, FLAGS_SUB, a, data, c, res); return res; } //SBC
+        case 4: { res = a & data; cpu_deferFlags(cpu, FLAGS_AND, 0, 0, 0, res); return res; } //AND
+        case 5: { res = a ^ data; cpu_deferFlags(cpu, FLAGS_LOGIC, 0, 0, 0, res); return res; } //XOR
+        case 6: { res = a | data; cpu_deferFlags(cpu, FLAGS_LOGIC, 0, 0, 0, res); return res; } //OR
+        default: { cpu_deferFlags(cpu, FLAGS_SUB, a, data, 0, a - data); return a; } //CP
+    }
+}
+
+#define CASE_ALU_OP(opcode, op, data, cycles) case (opcode) | (op) << 3: { A = cpu_alu(cpu, op, A, data); ticks = cycles; break; }
+#define CASE_ALU(opcode, data, cycles) CASE_ALU_OP(opcode, 0, data, cycles) CASE_ALU_OP(opcode, 1, data, cycles) \
+    CASE_ALU_OP(opcode, 2, data, cycles) CASE_ALU_OP(opcode, 3, data, cycles) CASE_ALU_OP(opcode, 4, data, cycles) \
+    CASE_ALU_OP(opcode, 5, data, cycles) CASE_ALU_OP(opcode, 6, data, cycles) CASE_ALU_OP(opcode, 7, data, cycles)
+
+//one group of cases per register: LD r8 from every source, LD (HL)/n8, INC, DEC and the ALU operations on it
+#define CASE_LD_R8_R8(d, s) case 0x40 | (d) << 3 | (s): { R8_SET(d, R8(s)); ticks = 4; break; }
+#define CASE_R8(r) CASE_LD_R8_R8(r, 0) CASE_LD_R8_R8(r, 1) CASE_LD_R8_R8(r, 2) CASE_LD_R8_R8(r, 3) \
+    CASE_LD_R8_R8(r, 4) CASE_LD_R8_R8(r, 5) CASE_LD_R8_R8(r, 7) \
+    case 0x46 | (r) << 3: { R8_SET(r, memory_read8(bus, HL)); ticks = 8; break; } \
+    case 0x70 | (r): { memory_write8(bus, HL, R8(r)); ticks = 8; break; } \
+    case 0x06 | (r) << 3: { R8_SET(r, operand); ticks = 8; break; } \
+    case 0x04 | (r) << 3: { R8_SET(r, instr_inc8(cpu, R8(r))); ticks = 4; break; } \
+    case 0x05 | (r) << 3: { R8_SET(r, instr_dec8(cpu, R8(r))); ticks = 4; break; } \
+    CASE_ALU(0x80 | (r), R8(r), 4)
+
+#define CASE_R16(r) \
+    case 0x01 | (r) << 4: { R16_SET(r, operand); ticks = 12; break; } \
+    case 0x03 | (r) << 4: { R16_SET(r, R16(r) + 1); ticks = 8; break; } \
+    case 0x0B | (r) << 4: { R16_SET(r, R16(r) - 1); ticks = 8; break; }
+
+//IME changing, HALT or an interrupt to dispatch: cpu_step handles them. An interrupt pending while IME is off
+//does nothing out of HALT
+static inline bool cpu_needs_step(Cpu* cpu)
+{
+    return (cpu->ei_delay | cpu->di_delay | cpu->is_HALT) || (cpu->bus->interrupt_pending && cpu->IME);
+}
+
+//run the predecoded instructions with the registers in locals. The loads, 8 bits ALU, INC/DEC and jumps run inline,
+//the other handlers get the registers written back before their call and read again after it.
+//Stops where cpu_step is needed: interrupt dispatch or IME change, HALT, start of a block for the JIT, code out of the cache
+static uint64_t cpu_run_cached(Cpu* cpu, uint64_t now, uint64_t deadline)
+{
+    Scheduler* scheduler = cpu->scheduler;
+    BlockCache* cache = cpu->block_cache;
+    Memory* bus = cpu->bus;
+    uint16_t BC, DE, HL, SP, PC;
+    uint8_t A;
+
+    CPU_REGS_LOAD(cpu);
+    while (now < deadline && now < scheduler->next) {
+        if (cpu_needs_step(cpu)) { break; }
+
+        scheduler->now = now; //timer reads during the instruction, idle loop skip up to the next event
+        const DecodedInstr* instr = block_cache_fetch(cache, PC);
+        if (!instr) { break; }
+        Block* block = cache->current;
+        if (cache->index == 1) { //at the start of a block
+            if (cpu->jit) { cache->index = 0; break; } //cpu_step fetches it again and runs the compiled block
+            if (block->self_loop) {
+                CPU_REGS_STORE(cpu);
+                uint32_t ticks = cpu_idle_skip(cpu, block);
+                if (ticks) { cache->index = 0; now += ticks; continue; } //still at the start of the loop
+            }
+        }
+
+        PC += instr->length;
+        uint16_t operand = instr->operand;
+        uint8_t opcode = instr->opcode;
+        uint32_t ticks;
+        switch ((instr->handler == opcode_table[opcode].handler) ? opcode : 0xCB) { //CB opcodes go to their handler
+            case 0x00: { ticks = 4; break; } //NOP
+            CASE_R8(0) CASE_R8(1) CASE_R8(2) CASE_R8(3) CASE_R8(4) CASE_R8(5) CASE_R8(7)
+            CASE_R16(0) CASE_R16(1) CASE_R16(2) CASE_R16(3)
+            CASE_ALU(0x86, memory_read8(bus, HL), 8) //ALU A, (HL)
+            CASE_ALU(0xC6, operand, 8) //ALU A, n8
+            case 0xF9: { SP = HL; ticks = 8; break; } //LD SP, HL
+            case 0x36: { memory_write8(bus, HL, operand); ticks = 12; break; } //LD (HL), n8
+            case 0x02: { memory_write8(bus, BC, A); ticks = 8; break; } //LD (BC), A
+            case 0x12: { memory_write8(bus, DE, A); ticks = 8; break; } //LD (DE), A
+            case 0x0A: { A = memory_read8(bus, BC); ticks = 8; break; } //LD A, (BC)
+            case 0x1A: { A = memory_read8(bus, DE); ticks = 8; break; } //LD A, (DE)
+            case 0x22: { memory_write8(bus, HL++, A); ticks = 8; break; } //LD (HL+), A
+            case 0x32: { memory_write8(bus, HL--, A); ticks = 8; break; } //LD (HL-), A
+            case 0x2A: { A = memory_read8(bus, HL++); ticks = 8; break; } //LD A, (HL+)
+            case 0x3A: { A = memory_read8(bus, HL--); ticks = 8; break; } //LD A, (HL-)
+            case 0xE0: { memory_write8(bus, 0xFF00 + operand, A); ticks = 12; break; } //LDH (a8), A
+            case 0xF0: { A = memory_read8(bus, 0xFF00 + operand); ticks = 12; break; } //LDH A, (a8)
+            case 0xE2: { memory_write8(bus, 0xFF00 + R8(1), A); ticks = 8; break; } //LDH (C), A
+            case 0xF2: { A = memory_read8(bus, 0xFF00 + R8(1)); ticks = 8; break; } //LDH A, (C)
+            case 0xEA: { memory_write8(bus, operand, A); ticks = 16; break; } //LD (a16), A
+            case 0xFA: { A = memory_read8(bus, operand); ticks = 16; break; } //LD A, (a16)
+            case 0x18: { PC += (int8_t)operand; ticks = 12; break; } //JR e8
+            case 0x20: case 0x28: case 0x30: case 0x38: { //JR cc, e8
+                if (cpu_condition(cpu, opcode)) { PC += (int8_t)operand; ticks = 12; }
+                else { ticks = 8; }
+                break;
+            }
+            case 0xC3: { PC = operand; ticks = 16; break; } //JP a16
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA: { //JP cc, a16
+                if (cpu_condition(cpu, opcode)) { PC = operand; ticks = 16; }
+                else { ticks = 12; }
+                break;
+            }
+            default: {
+                CPU_REGS_STORE(cpu);
+                ticks = instr->handler(cpu, opcode, operand);
+                CPU_REGS_LOAD(cpu);
+                break;
+            }
+        }
+
+        if (cpu->idle.block) { //count the iteration, or stop watching once it left the loop
+            if (cpu->idle.block == block) { cpu->idle.cycles += ticks; }
+            else { cpu->idle.block = NULL; }
+        }
+        now += ticks;
+    }
+    CPU_REGS_STORE(cpu);
+
+    return now;
+}
+
+//run until the scheduler reaches deadline or its next event, the clock stays in a local between the instructions
+//and the registers too while the block cache runs them
+void cpu_run_until(Cpu* cpu, uint64_t deadline)
+{
+    if (!cpu || !cpu->scheduler)
+        abort();
+
+    Scheduler* scheduler = cpu->scheduler;
+    uint64_t now = scheduler->now;
+
+    while (now < deadline && now < scheduler->next) { //next moves when an instruction reschedules an event
+        if (cpu->block_cache && !cpu_needs_step(cpu)) {
+            now = cpu_run_cached(cpu, now, deadline);
+            if (now >= deadline || now >= scheduler->next) { break; }
+        }
+        scheduler->now = now; //timer reads during the instruction
+        now += cpu_step(cpu);
+    }
+
+    scheduler->now = now;
+}
 /********************************   INTERRUPTION MANAGEMENT *******************************************/
 static void handle_interrupt(Cpu* cpu, uint16_t interrupt_address, uint8_t interrupt_type, uint8_t reg_if)
 {
@@ -137,6 +528,7 @@ static void handle_interrupt(Cpu* cpu, uint16_t interrupt_address, uint8_t inter
     //clear the bit requesting interrupt
     instr_push(cpu, cpu->PC);
     cpu->PC = interrupt_address;
+    if (cpu->block_cache) { cpu->block_cache->current = NULL; } //leave the block running at the old PC
     memory_write8(cpu->bus, 0xFF0F, reg_if & ~(interrupt_type));
     cpu->IME = false;
 }
@@ -145,46 +537,411 @@ uint32_t handle_interrupts(Cpu* cpu)
 {
     if (!cpu) { abort(); }
 
-    uint8_t ie_reg = memory_read8(cpu->bus, IE);
-    uint8_t if_reg = memory_read8(cpu->bus, IF);
-    uint8_t requested_interrupt = ie_reg & if_reg;
-
-    if ((requested_interrupt & 0x1F) == 0x0) return 0;
+    uint8_t requested_interrupt = cpu->bus->interrupt_pending;
+    if (requested_interrupt == 0x0) return 0;
 
     cpu->is_HALT = false;
 
     if (cpu->IME == false)
         return 0;
-    
-    //VBLANK
-    if (VBLANK & requested_interrupt) {
-        handle_interrupt(cpu, VBLANK_ADDR, 1, if_reg);
-        return 25;
-    }
-    //LCD
-    if (LCD & requested_interrupt) {
-        handle_interrupt(cpu, LCD_ADDR, 2, if_reg);
-        return 25;
-    }
-    //TIMER
-    if (TIMER & requested_interrupt) {
-        handle_interrupt(cpu, TIMER_ADDR, 4, if_reg);
-        return 25;
-    }
-    //SERIAL
-    if (SERIAL & requested_interrupt) {
-        handle_interrupt(cpu, SERIAL_ADDR, 8, if_reg);
-        return 25;
-    }
-    //JOYPAD
-    if (JOYPAD & requested_interrupt) {
-        handle_interrupt(cpu, JOYPAD_ADDR, 16, if_reg);
-        return 25;
-    }
 
-    return 0;
+    //the lowest bit has the highest priority: VBLANK, LCD, TIMER, SERIAL, JOYPAD
+    uint8_t bit = __builtin_ctz(requested_interrupt);
+    handle_interrupt(cpu, VBLANK_ADDR + bit * 8, 1 << bit, cpu->bus->interrupt_requested);
+    return 25;
 }
 
+/********************************   OPCODE HANDLERS *******************************************/
+//every handler receives its opcode (to decode the register/condition fields) and the operand
+//already fetched by the dispatcher (n8/e8/a16 depending on the length in the opcode table)
+
+//condition field of JR/JP/CALL/RET cc: NZ, Z, NC, C
+static bool cpu_condition(Cpu* cpu, uint8_t opcode)
+{
+    uint8_t cc = (opcode >> 3) & 0x3;
+    Flag flag = (cc & 0x2) ? C_FLAG : Z_FLAG;
+    return cpu_getFlag(cpu, flag) == (cc & 0x1);
+}
+
+static void (*const alu_ops[8])(Cpu* cpu, uint8_t data) = {
+    instr_add8, instr_adc, instr_sub, instr_sbc, instr_and, instr_xor, instr_or, instr_cp
+};
+
+static uint8_t (*const shift_ops[8])(Cpu* cpu, uint8_t data) = {
+    instr_rlc, instr_rrc, instr_rl, instr_rr, instr_sla, instr_sra, instr_swap, instr_srl
+};
+
+static uint32_t op_illegal(Cpu* cpu, uint8_t opcode, uint16_t operand) { fprintf(stderr, "[ERROR] : ILLEGAL INSTRUCTION"); abort(); }
+static uint32_t op_nop(Cpu* cpu, uint8_t opcode, uint16_t operand) { return 4; }
+static uint32_t op_stop(Cpu* cpu, uint8_t opcode, uint16_t operand) { return 4; }
+static uint32_t op_halt(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->is_HALT = true; return 4; }
+static uint32_t op_di(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->di_delay = 2; return 4; }
+static uint32_t op_ei(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->ei_delay = 2; return 4; }
+
+//8 bits loads
+static uint32_t op_ld_r8_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { *cpu->r8[(opcode >> 3) & 0x7] = *cpu->r8[opcode & 0x7]; return 4; }
+static uint32_t op_ld_r8_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { *cpu->r8[(opcode >> 3) & 0x7] = memory_read8(cpu->bus, cpu->HL.r16); return 8; }
+static uint32_t op_ld_hlind_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, *cpu->r8[opcode & 0x7]); return 8; }
+static uint32_t op_ld_r8_n8(Cpu* cpu, uint8_t opcode, uint16_t operand) { *cpu->r8[(opcode >> 3) & 0x7] = operand; return 8; }
+static uint32_t op_ld_hlind_n8(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, operand); return 12; }
+static uint32_t op_ld_r16ind_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, *cpu->r16[(opcode >> 4) & 0x3], cpu->AF.r8.hi); return 8; }
+static uint32_t op_ld_a_r16ind(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, *cpu->r16[(opcode >> 4) & 0x3]); return 8; }
+static uint32_t op_ld_hli_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, cpu->AF.r8.hi); cpu->HL.r16++; return 8; }
+static uint32_t op_ld_hld_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, cpu->AF.r8.hi); cpu->HL.r16--; return 8; }
+static uint32_t op_ld_a_hli(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); cpu->HL.r16++; return 8; }
+static uint32_t op_ld_a_hld(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); cpu->HL.r16--; return 8; }
+static uint32_t op_ldh_a8_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, (0xFF00 + operand), cpu->AF.r8.hi); return 12; }
+static uint32_t op_ldh_a_a8(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, (0xFF00 + operand)); return 12; }
+static uint32_t op_ldh_c_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, (0xFF00 + cpu->BC.r8.lo), cpu->AF.r8.hi); return 8; }
+static uint32_t op_ldh_a_c(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, (0xFF00 + cpu->BC.r8.lo)); return 8; }
+static uint32_t op_ld_a16_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, operand, cpu->AF.r8.hi); return 16; }
+static uint32_t op_ld_a_a16(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = memory_read8(cpu->bus, operand); return 16; }
+
+//16 bits loads
+static uint32_t op_ld_r16_n16(Cpu* cpu, uint8_t opcode, uint16_t operand) { *cpu->r16[(opcode >> 4) & 0x3] = operand; return 12; }
+static uint32_t op_ld_a16_sp(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write16(cpu->bus, operand, cpu->SP); return 20; }
+static uint32_t op_ld_sp_hl(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->SP = cpu->HL.r16; return 8; }
+static uint32_t op_ld_hl_sp_e8(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->HL.r16 = instr_add16imm(cpu, (int8_t)operand); return 12; }
+static uint32_t op_push_r16(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu_syncFlags(cpu); instr_push(cpu, *cpu->r16_stack[(opcode >> 4) & 0x3]); return 16; } //F of PUSH AF
+static uint32_t op_pop_r16(Cpu* cpu, uint8_t opcode, uint16_t operand) { *cpu->r16_stack[(opcode >> 4) & 0x3] = instr_pop(cpu); return 12; }
+static uint32_t op_pop_af(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r16 = instr_pop(cpu) & 0xFFF0; cpu->flag_op = FLAGS_SYNCED; return 12; } //set 4low bits to 0
+
+//8 bits arithmetic
+static uint32_t op_alu_a_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { alu_ops[(opcode >> 3) & 0x7](cpu, *cpu->r8[opcode & 0x7]); return 4; }
+static uint32_t op_alu_a_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { alu_ops[(opcode >> 3) & 0x7](cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; }
+static uint32_t op_alu_a_n8(Cpu* cpu, uint8_t opcode, uint16_t operand) { alu_ops[(opcode >> 3) & 0x7](cpu, operand); return 8; }
+static uint32_t op_inc_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { uint8_t* r8 = cpu->r8[(opcode >> 3) & 0x7]; *r8 = instr_inc8(cpu, *r8); return 4; }
+static uint32_t op_dec_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { uint8_t* r8 = cpu->r8[(opcode >> 3) & 0x7]; *r8 = instr_dec8(cpu, *r8); return 4; }
+static uint32_t op_inc_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, instr_inc8(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 12; }
+static uint32_t op_dec_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, instr_dec8(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 12; }
+static uint32_t op_daa(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_daa(cpu); return 4; }
+static uint32_t op_cpl(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_cpl(cpu); return 4; }
+static uint32_t op_scf(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_scf(cpu); return 4; }
+static uint32_t op_ccf(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_ccf(cpu); return 4; }
+static uint32_t op_rotate_a(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->AF.r8.hi = shift_ops[(opcode >> 3) & 0x3](cpu, cpu->AF.r8.hi); cpu_updateFlag(cpu, Z_FLAG, false); return 4; } //RLCA, RRCA, RLA, RRA
+
+//16 bits arithmetic
+static uint32_t op_inc_r16(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_inc16(cpu->r16[(opcode >> 4) & 0x3]); return 8; }
+static uint32_t op_dec_r16(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_dec16(cpu->r16[(opcode >> 4) & 0x3]); return 8; }
+static uint32_t op_add_hl_r16(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_add16(cpu, *cpu->r16[(opcode >> 4) & 0x3]); return 8; }
+static uint32_t op_add_sp_e8(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->SP = instr_add16imm(cpu, (int8_t)operand); return 16; }
+
+//jumps and calls (the PC already points to the next instruction)
+static uint32_t op_jr(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_jr(cpu, (int8_t)operand); return 12; }
+static uint32_t op_jr_cc(Cpu* cpu, uint8_t opcode, uint16_t operand) { if (cpu_condition(cpu, opcode)) { instr_jr(cpu, (int8_t)operand); return 12; } else { return 8; } }
+static uint32_t op_jp(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->PC = operand; return 16; }
+static uint32_t op_jp_cc(Cpu* cpu, uint8_t opcode, uint16_t operand) { if (cpu_condition(cpu, opcode)) { cpu->PC = operand; return 16; } else { return 12; } }
+static uint32_t op_jp_hl(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->PC = cpu->HL.r16; return 4; }
+static uint32_t op_call(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_push(cpu, cpu->PC); cpu->PC = operand; return 24; }
+static uint32_t op_call_cc(Cpu* cpu, uint8_t opcode, uint16_t operand) { if (cpu_condition(cpu, opcode)) { instr_push(cpu, cpu->PC); cpu->PC = operand; return 24; } else { return 12; } }
+static uint32_t op_ret(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->PC = instr_pop(cpu); return 16; }
+static uint32_t op_ret_cc(Cpu* cpu, uint8_t opcode, uint16_t operand) { if (cpu_condition(cpu, opcode)) { cpu->PC = instr_pop(cpu); return 20; } else { return 8; } }
+static uint32_t op_reti(Cpu* cpu, uint8_t opcode, uint16_t operand) { cpu->IME = true; cpu->PC = instr_pop(cpu); return 16; } //no delay time like ei to enable IME
+static uint32_t op_rst(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_push(cpu, cpu->PC); cpu->PC = opcode & 0x38; return 16; }
+static uint32_t op_prefix_cb(Cpu* cpu, uint8_t opcode, uint16_t operand) { return cpu_execute_instruction_CB(cpu, operand); }
+
+//CB prefixed: the operation is in bits 3-7 and the r8 operand in bits 0-2
+static uint32_t op_cb_shift_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { uint8_t* r8 = cpu->r8[opcode & 0x7]; *r8 = shift_ops[(opcode >> 3) & 0x7](cpu, *r8); return 8; }
+static uint32_t op_cb_shift_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, shift_ops[(opcode >> 3) & 0x7](cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; }
+static uint32_t op_cb_bit_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_bit(cpu, (opcode >> 3) & 0x7, *cpu->r8[opcode & 0x7]); return 8; }
+static uint32_t op_cb_bit_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { instr_bit(cpu, (opcode >> 3) & 0x7, memory_read8(cpu->bus, cpu->HL.r16)); return 12; }
+static uint32_t op_cb_res_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { uint8_t* r8 = cpu->r8[opcode & 0x7]; *r8 = instr_res((opcode >> 3) & 0x7, *r8); return 8; }
+static uint32_t op_cb_res_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, instr_res((opcode >> 3) & 0x7, memory_read8(cpu->bus, cpu->HL.r16))); return 16; }
+static uint32_t op_cb_set_r8(Cpu* cpu, uint8_t opcode, uint16_t operand) { uint8_t* r8 = cpu->r8[opcode & 0x7]; *r8 = instr_set((opcode >> 3) & 0x7, *r8); return 8; }
+static uint32_t op_cb_set_hlind(Cpu* cpu, uint8_t opcode, uint16_t operand) { memory_write8(cpu->bus, cpu->HL.r16, instr_set((opcode >> 3) & 0x7, memory_read8(cpu->bus, cpu->HL.r16))); return 16; }
+
+/********************************   OPCODE TABLES *******************************************/
+//length is the opcode byte plus its operand bytes, the dispatcher fetches the operand before calling the handler
+//jump is set for the instructions that may load the PC (end of a basic block)
+
+const Opcode opcode_table[256] = {
+    [0x00] = { op_nop, 1, false }, //NOP
+    [0x01] = { op_ld_r16_n16, 3, false }, //LD BC, n16
+    [0x02] = { op_ld_r16ind_a, 1, false }, //LD (BC), A
+    [0x03] = { op_inc_r16, 1, false }, //INC BC
+    [0x04] = { op_inc_r8, 1, false }, //INC B
+    [0x05] = { op_dec_r8, 1, false }, //DEC B
+    [0x06] = { op_ld_r8_n8, 2, false }, //LD B, n8
+    [0x07] = { op_rotate_a, 1, false }, //RLCA
+    [0x08] = { op_ld_a16_sp, 3, false }, //LD (a16), SP
+    [0x09] = { op_add_hl_r16, 1, false }, //ADD HL, BC
+    [0x0A] = { op_ld_a_r16ind, 1, false }, //LD A, (BC)
+    [0x0B] = { op_dec_r16, 1, false }, //DEC BC
+    [0x0C] = { op_inc_r8, 1, false }, //INC C
+    [0x0D] = { op_dec_r8, 1, false }, //DEC C
+    [0x0E] = { op_ld_r8_n8, 2, false }, //LD C, n8
+    [0x0F] = { op_rotate_a, 1, false }, //RRCA
+
+    [0x10] = { op_stop, 2, false }, //STOP
+    [0x11] = { op_ld_r16_n16, 3, false }, //LD DE, n16
+    [0x12] = { op_ld_r16ind_a, 1, false }, //LD (DE), A
+    [0x13] = { op_inc_r16, 1, false }, //INC DE
+    [0x14] = { op_inc_r8, 1, false }, //INC D
+    [0x15] = { op_dec_r8, 1, false }, //DEC D
+    [0x16] = { op_ld_r8_n8, 2, false }, //LD D, n8
+    [0x17] = { op_rotate_a, 1, false }, //RLA
+    [0x18] = { op_jr, 2, true }, //JR e8
+    [0x19] = { op_add_hl_r16, 1, false }, //ADD HL, DE
+    [0x1A] = { op_ld_a_r16ind, 1, false }, //LD A, (DE)
+    [0x1B] = { op_dec_r16, 1, false }, //DEC DE
+    [0x1C] = { op_inc_r8, 1, false }, //INC E
+    [0x1D] = { op_dec_r8, 1, false }, //DEC E
+    [0x1E] = { op_ld_r8_n8, 2, false }, //LD E, n8
+    [0x1F] = { op_rotate_a, 1, false }, //RRA
+
+    [0x20] = { op_jr_cc, 2, true }, //JR NZ, e8
+    [0x21] = { op_ld_r16_n16, 3, false }, //LD HL, n16
+    [0x22] = { op_ld_hli_a, 1, false }, //LD (HL+), A
+    [0x23] = { op_inc_r16, 1, false }, //INC HL
+    [0x24] = { op_inc_r8, 1, false }, //INC H
+    [0x25] = { op_dec_r8, 1, false }, //DEC H
+    [0x26] = { op_ld_r8_n8, 2, false }, //LD H, n8
+    [0x27] = { op_daa, 1, false }, //DAA
+    [0x28] = { op_jr_cc, 2, true }, //JR Z, e8
+    [0x29] = { op_add_hl_r16, 1, false }, //ADD HL, HL
+    [0x2A] = { op_ld_a_hli, 1, false }, //LD A, (HL+)
+    [0x2B] = { op_dec_r16, 1, false }, //DEC HL
+    [0x2C] = { op_inc_r8, 1, false }, //INC L
+    [0x2D] = { op_dec_r8, 1, false }, //DEC L
+    [0x2E] = { op_ld_r8_n8, 2, false }, //LD L, n8
+    [0x2F] = { op_cpl, 1, false }, //CPL
+
+    [0x30] = { op_jr_cc, 2, true }, //JR NC, e8
+    [0x31] = { op_ld_r16_n16, 3, false }, //LD SP, n16
+    [0x32] = { op_ld_hld_a, 1, false }, //LD (HL-), A
+    [0x33] = { op_inc_r16, 1, false }, //INC SP
+    [0x34] = { op_inc_hlind, 1, false }, //INC (HL)
+    [0x35] = { op_dec_hlind, 1, false }, //DEC (HL)
+    [0x36] = { op_ld_hlind_n8, 2, false }, //LD (HL), n8
+    [0x37] = { op_scf, 1, false }, //SCF
+    [0x38] = { op_jr_cc, 2, true }, //JR C, e8
+    [0x39] = { op_add_hl_r16, 1, false }, //ADD HL, SP
+    [0x3A] = { op_ld_a_hld, 1, false }, //LD A, (HL-)
+    [0x3B] = { op_dec_r16, 1, false }, //DEC SP
+    [0x3C] = { op_inc_r8, 1, false }, //INC A
+    [0x3D] = { op_dec_r8, 1, false }, //DEC A
+    [0x3E] = { op_ld_r8_n8, 2, false }, //LD A, n8
+    [0x3F] = { op_ccf, 1, false }, //CCF
+
+    [0x40] = { op_ld_r8_r8, 1, false }, //LD B, B
+    [0x41] = { op_ld_r8_r8, 1, false }, //LD B, C
+    [0x42] = { op_ld_r8_r8, 1, false }, //LD B, D
+    [0x43] = { op_ld_r8_r8, 1, false }, //LD B, E
+    [0x44] = { op_ld_r8_r8, 1, false }, //LD B, H
+    [0x45] = { op_ld_r8_r8, 1, false }, //LD B, L
+    [0x46] = { op_ld_r8_hlind, 1, false }, //LD B, (HL)
+    [0x47] = { op_ld_r8_r8, 1, false }, //LD B, A
+    [0x48] = { op_ld_r8_r8, 1, false }, //LD C, B
+    [0x49] = { op_ld_r8_r8, 1, false }, //LD C, C
+    [0x4A] = { op_ld_r8_r8, 1, false }, //LD C, D
+    [0x4B] = { op_ld_r8_r8, 1, false }, //LD C, E
+    [0x4C] = { op_ld_r8_r8, 1, false }, //LD C, H
+    [0x4D] = { op_ld_r8_r8, 1, false }, //LD C, L
+    [0x4E] = { op_ld_r8_hlind, 1, false }, //LD C, (HL)
+    [0x4F] = { op_ld_r8_r8, 1, false }, //LD C, A
+
+    [0x50] = { op_ld_r8_r8, 1, false }, //LD D, B
+    [0x51] = { op_ld_r8_r8, 1, false }, //LD D, C
+    [0x52] = { op_ld_r8_r8, 1, false }, //LD D, D
+    [0x53] = { op_ld_r8_r8, 1, false }, //LD D, E
+    [0x54] = { op_ld_r8_r8, 1, false }, //LD D, H
+    [0x55] = { op_ld_r8_r8, 1, false }, //LD D, L
+    [0x56] = { op_ld_r8_hlind, 1, false }, //LD D, (HL)
+    [0x57] = { op_ld_r8_r8, 1, false }, //LD D, A
+    [0x58] = { op_ld_r8_r8, 1, false }, //LD E, B
+    [0x59] = { op_ld_r8_r8, 1, false }, //LD E, C
+    [0x5A] = { op_ld_r8_r8, 1, false }, //LD E, D
+    [0x5B] = { op_ld_r8_r8, 1, false }, //LD E, E
+    [0x5C] = { op_ld_r8_r8, 1, false }, //LD E, H
+    [0x5D] = { op_ld_r8_r8, 1, false }, //LD E, L
+    [0x5E] = { op_ld_r8_hlind, 1, false }, //LD E, (HL)
+    [0x5F] = { op_ld_r8_r8, 1, false }, //LD E, A
+
+    [0x60] = { op_ld_r8_r8, 1, false }, //LD H, B
+    [0x61] = { op_ld_r8_r8, 1, false }, //LD H, C
+    [0x62] = { op_ld_r8_r8, 1, false }, //LD H, D
+    [0x63] = { op_ld_r8_r8, 1, false }, //LD H, E
+    [0x64] = { op_ld_r8_r8, 1, false }, //LD H, H
+    [0x65] = { op_ld_r8_r8, 1, false }, //LD H, L
+    [0x66] = { op_ld_r8_hlind, 1, false }, //LD H, (HL)
+    [0x67] = { op_ld_r8_r8, 1, false }, //LD H, A
+    [0x68] = { op_ld_r8_r8, 1, false }, //LD L, B
+    [0x69] = { op_ld_r8_r8, 1, false }, //LD L, C
+    [0x6A] = { op_ld_r8_r8, 1, false }, //LD L, D
+    [0x6B] = { op_ld_r8_r8, 1, false }, //LD L, E
+    [0x6C] = { op_ld_r8_r8, 1, false }, //LD L, H
+    [0x6D] = { op_ld_r8_r8, 1, false }, //LD L, L
+    [0x6E] = { op_ld_r8_hlind, 1, false }, //LD L, (HL)
+    [0x6F] = { op_ld_r8_r8, 1, false }, //LD L, A
+
+    [0x70] = { op_ld_hlind_r8, 1, false }, //LD (HL), B
+    [0x71] = { op_ld_hlind_r8, 1, false }, //LD (HL), C
+    [0x72] = { op_ld_hlind_r8, 1, false }, //LD (HL), D
+    [0x73] = { op_ld_hlind_r8, 1, false }, //LD (HL), E
+    [0x74] = { op_ld_hlind_r8, 1, false }, //LD (HL), H
+    [0x75] = { op_ld_hlind_r8, 1, false }, //LD (HL), L
+    [0x76] = { op_halt, 1, false }, //HALT
+    [0x77] = { op_ld_hlind_r8, 1, false }, //LD (HL), A
+    [0x78] = { op_ld_r8_r8, 1, false }, //LD A, B
+    [0x79] = { op_ld_r8_r8, 1, false }, //LD A, C
+    [0x7A] = { op_ld_r8_r8, 1, false }, //LD A, D
+    [0x7B] = { op_ld_r8_r8, 1, false }, //LD A, E
+    [0x7C] = { op_ld_r8_r8, 1, false }, //LD A, H
+    [0x7D] = { op_ld_r8_r8, 1, false }, //LD A, L
+    [0x7E] = { op_ld_r8_hlind, 1, false }, //LD A, (HL)
+    [0x7F] = { op_ld_r8_r8, 1, false }, //LD A, A
+
+    [0x80] = { op_alu_a_r8, 1, false }, //ADD A, B
+    [0x81] = { op_alu_a_r8, 1, false }, //ADD A, C
+    [0x82] = { op_alu_a_r8, 1, false }, //ADD A, D
+    [0x83] = { op_alu_a_r8, 1, false }, //ADD A, E
+    [0x84] = { op_alu_a_r8, 1, false }, //ADD A, H
+    [0x85] = { op_alu_a_r8, 1, false }, //ADD A, L
+    [0x86] = { op_alu_a_hlind, 1, false }, //ADD A, (HL)
+    [0x87] = { op_alu_a_r8, 1, false }, //ADD A, A
+    [0x88] = { op_alu_a_r8, 1, false }, //ADC A, B
+    [0x89] = { op_alu_a_r8, 1, false }, //ADC A, C
+    [0x8A] = { op_alu_a_r8, 1, false }, //ADC A, D
+    [0x8B] = { op_alu_a_r8, 1, false }, //ADC A, E
+    [0x8C] = { op_alu_a_r8, 1, false }, //ADC A, H
+    [0x8D] = { op_alu_a_r8, 1, false }, //ADC A, L
+    [0x8E] = { op_alu_a_hlind, 1, false }, //ADC A, (HL)
+    [0x8F] = { op_alu_a_r8, 1, false }, //ADC A, A
+
+    [0x90] = { op_alu_a_r8, 1, false }, //SUB A, B
+    [0x91] = { op_alu_a_r8, 1, false }, //SUB A, C
+    [0x92] = { op_alu_a_r8, 1, false }, //SUB A, D
+    [0x93] = { op_alu_a_r8, 1, false }, //SUB A, E
+    [0x94] = { op_alu_a_r8, 1, false }, //SUB A, H
+    [0x95] = { op_alu_a_r8, 1, false }, //SUB A, L
+    [0x96] = { op_alu_a_hlind, 1, false }, //SUB A, (HL)
+    [0x97] = { op_alu_a_r8, 1, false }, //SUB A, A
+    [0x98] = { op_alu_a_r8, 1, false }, //SBC A, B
+    [0x99] = { op_alu_a_r8, 1, false }, //SBC A, C
+    [0x9A] = { op_alu_a_r8, 1, false }, //SBC A, D
+    [0x9B] = { op_alu_a_r8, 1, false }, //SBC A, E
+    [0x9C] = { op_alu_a_r8, 1, false }, //SBC A, H
+    [0x9D] = { op_alu_a_r8, 1, false }, //SBC A, L
+    [0x9E] = { op_alu_a_hlind, 1, false }, //SBC A, (HL)
+    [0x9F] = { op_alu_a_r8, 1, false }, //SBC A, A
+
+    [0xA0] = { op_alu_a_r8, 1, false }, //AND A, B
+    [0xA1] = { op_alu_a_r8, 1, false }, //AND A, C
+    [0xA2] = { op_alu_a_r8, 1, false }, //AND A, D
+    [0xA3] = { op_alu_a_r8, 1, false }, //AND A, E
+    [0xA4] = { op_alu_a_r8, 1, false }, //AND A, H
+    [0xA5] = { op_alu_a_r8, 1, false }, //AND A, L
+    [0xA6] = { op_alu_a_hlind, 1, false }, //AND A, (HL)
+    [0xA7] = { op_alu_a_r8, 1, false }, //AND A, A
+    [0xA8] = { op_alu_a_r8, 1, false }, //XOR A, B
+    [0xA9] = { op_alu_a_r8, 1, false }, //XOR A, C
+    [0xAA] = { op_alu_a_r8, 1, false }, //XOR A, D
+    [0xAB] = { op_alu_a_r8, 1, false }, //XOR A, E
+    [0xAC] = { op_alu_a_r8, 1, false }, //XOR A, H
+    [0xAD] = { op_alu_a_r8, 1, false }, //XOR A, L
+    [0xAE] = { op_alu_a_hlind, 1, false }, //XOR A, (HL)
+    [0xAF] = { op_alu_a_r8, 1, false }, //XOR A, A
+
+    [0xB0] = { op_alu_a_r8, 1, false }, //OR A, B
+    [0xB1] = { op_alu_a_r8, 1, false }, //OR A, C
+    [0xB2] = { op_alu_a_r8, 1, false }, //OR A, D
+    [0xB3] = { op_alu_a_r8, 1, false }, //OR A, E
+    [0xB4] = { op_alu_a_r8, 1, false }, //OR A, H
+    [0xB5] = { op_alu_a_r8, 1, false }, //OR A, L
+    [0xB6] = { op_alu_a_hlind, 1, false }, //OR A, (HL)
+    [0xB7] = { op_alu_a_r8, 1, false }, //OR A, A
+    [0xB8] = { op_alu_a_r8, 1, false }, //CP A, B
+    [0xB9] = { op_alu_a_r8, 1, false }, //CP A, C
+    [0xBA] = { op_alu_a_r8, 1, false }, //CP A, D
+    [0xBB] = { op_alu_a_r8, 1, false }, //CP A, E
+    [0xBC] = { op_alu_a_r8, 1, false }, //CP A, H
+    [0xBD] = { op_alu_a_r8, 1, false }, //CP A, L
+    [0xBE] = { op_alu_a_hlind, 1, false }, //CP A, (HL)
+    [0xBF] = { op_alu_a_r8, 1, false }, //CP A, A
+
+    [0xC0] = { op_ret_cc, 1, true }, //RET NZ
+    [0xC1] = { op_pop_r16, 1, false }, //POP BC
+    [0xC2] = { op_jp_cc, 3, true }, //JP NZ, a16
+    [0xC3] = { op_jp, 3, true }, //JP a16
+    [0xC4] = { op_call_cc, 3, true }, //CALL NZ, a16
+    [0xC5] = { op_push_r16, 1, false }, //PUSH BC
+    [0xC6] = { op_alu_a_n8, 2, false }, //ADD A, n8
+    [0xC7] = { op_rst, 1, true }, //RST $00
+    [0xC8] = { op_ret_cc, 1, true }, //RET Z
+    [0xC9] = { op_ret, 1, true }, //RET
+    [0xCA] = { op_jp_cc, 3, true }, //JP Z, a16
+    [0xCB] = { op_prefix_cb, 2, false }, //PREFIX CB
+    [0xCC] = { op_call_cc, 3, true }, //CALL Z, a16
+    [0xCD] = { op_call, 3, true }, //CALL a16
+    [0xCE] = { op_alu_a_n8, 2, false }, //ADC A, n8
+    [0xCF] = { op_rst, 1, true }, //RST $08
+
+    [0xD0] = { op_ret_cc, 1, true }, //RET NC
+    [0xD1] = { op_pop_r16, 1, false }, //POP DE
+    [0xD2] = { op_jp_cc, 3, true }, //JP NC, a16
+    [0xD3] = { op_illegal, 1, false }, //ILLEGAL
+    [0xD4] = { op_call_cc, 3, true }, //CALL NC, a16
+    [0xD5] = { op_push_r16, 1, false }, //PUSH DE
+    [0xD6] = { op_alu_a_n8, 2, false }, //SUB A, n8
+    [0xD7] = { op_rst, 1, true }, //RST $10
+    [0xD8] = { op_ret_cc, 1, true }, //RET C
+    [0xD9] = { op_reti, 1, true }, //RETI
+    [0xDA] = { op_jp_cc, 3, true }, //JP C, a16
+    [0xDB] = { op_illegal, 1, false }, //ILLEGAL
+    [0xDC] = { op_call_cc, 3, true }, //CALL C, a16
+    [0xDD] = { op_illegal, 1, false }, //ILLEGAL
+    [0xDE] = { op_alu_a_n8, 2, false }, //SBC A, n8
+    [0xDF] = { op_rst, 1, true }, //RST $18
+
+    [0xE0] = { op_ldh_a8_a, 2, false }, //LDH (a8), A
+    [0xE1] = { op_pop_r16, 1, false }, //POP HL
+    [0xE2] = { op_ldh_c_a, 1, false }, //LD (C), A
+    [0xE3] = { op_illegal, 1, false }, //ILLEGAL
+    [0xE4] = { op_illegal, 1, false }, //ILLEGAL
+    [0xE5] = { op_push_r16, 1, false }, //PUSH HL
+    [0xE6] = { op_alu_a_n8, 2, false }, //AND A, n8
+    [0xE7] = { op_rst, 1, true }, //RST $20
+    [0xE8] = { op_add_sp_e8, 2, false }, //ADD SP, e8
+    [0xE9] = { op_jp_hl, 1, true }, //JP HL
+    [0xEA] = { op_ld_a16_a, 3, false }, //LD (a16), A
+    [0xEB] = { op_illegal, 1, false }, //ILLEGAL
+    [0xEC] = { op_illegal, 1, false }, //ILLEGAL
+    [0xED] = { op_illegal, 1, false }, //ILLEGAL
+    [0xEE] = { op_alu_a_n8, 2, false }, //XOR A, n8
+    [0xEF] = { op_rst, 1, true }, //RST $28
+
+    [0xF0] = { op_ldh_a_a8, 2, false }, //LDH A, (n8)
+    [0xF1] = { op_pop_af, 1, false }, //POP AF
+    [0xF2] = { op_ldh_a_c, 1, false }, //LD A, (C)
+    [0xF3] = { op_di, 1, false }, //DI
+    [0xF4] = { op_illegal, 1, false }, //ILLEGAL
+    [0xF5] = { op_push_r16, 1, false }, //PUSH AF
+    [0xF6] = { op_alu_a_n8, 2, false }, //OR A, n8
+    [0xF7] = { op_rst, 1, true }, //RST $30
+    [0xF8] = { op_ld_hl_sp_e8, 2, false }, //LD HL, SP + e8
+    [0xF9] = { op_ld_sp_hl, 1, false }, //LD SP, HL
+    [0xFA] = { op_ld_a_a16, 3, false }, //LD A, (a16)
+    [0xFB] = { op_ei, 1, false }, //EI
+    [0xFC] = { op_illegal, 1, false }, //ILLEGAL
+    [0xFD] = { op_illegal, 1, false }, //ILLEGAL
+    [0xFE] = { op_alu_a_n8, 2, false }, //CP A, n8
+    [0xFF] = { op_rst, 1, true }, //RST $38
+};
+
+//one row is the 8 r8 operands (B, C, D, E, H, L, (HL), A) of a CB operation
+#define CB_ROW(r8, hlind) \
+    { r8, 2, false }, { r8, 2, false }, { r8, 2, false }, { r8, 2, false }, { r8, 2, false }, { r8, 2, false }, { hlind, 2, false }, { r8, 2, false }
+#define CB_ROWS(r8, hlind) \
+    CB_ROW(r8, hlind), CB_ROW(r8, hlind), CB_ROW(r8, hlind), CB_ROW(r8, hlind), \
+    CB_ROW(r8, hlind), CB_ROW(r8, hlind), CB_ROW(r8, hlind), CB_ROW(r8, hlind)
+
+const Opcode opcode_table_CB[256] = {
+    CB_ROWS(op_cb_shift_r8, op_cb_shift_hlind), //0x00 - 0x3F RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+    CB_ROWS(op_cb_bit_r8, op_cb_bit_hlind),     //0x40 - 0x7F BIT 0-7
+    CB_ROWS(op_cb_res_r8, op_cb_res_hlind),     //0x80 - 0xBF RES 0-7
+    CB_ROWS(op_cb_set_r8, op_cb_set_hlind)      //0xC0 - 0xFF SET 0-7
+};
+
 /************************************************************************************************************************ */
 
 uint32_t cpu_execute_instruction(Cpu* cpu, uint8_t opcode)
@@ -195,272 +952,17 @@ uint32_t cpu_execute_instruction(Cpu* cpu, uint8_t opcode)
     #ifdef DEBUG
         printf("OPCODE = %2X\n", opcode);
     #endif
-    
-    switch (opcode) {
-        case 0x00: { return 4; } //NOP
-        case 0x01: { cpu->BC.r16 = cpu_fetch_word_pc(cpu); return 12; } //LD BC, n16
-        case 0x02: { memory_write8(cpu->bus, cpu->BC.r16, cpu->AF.r8.hi); return 8; } //LD (BC), A
-        case 0x03: { instr_inc16(&cpu->BC.r16); return 8; } //INC BC
-        case 0x04: { cpu->BC.r8.hi = instr_inc8(cpu, cpu->BC.r8.hi); return 4; } //INC B
-        case 0x05: { cpu->BC.r8.hi = instr_dec8(cpu, cpu->BC.r8.hi); return 4; } //DEC B
-        case 0x06: { cpu->BC.r8.hi = cpu_fetch_byte_pc(cpu); return 8; } //LD B, n8
-        case 0x07: { cpu->AF.r8.hi = instr_rlc(cpu, cpu->AF.r8.hi); cpu_updateFlag(cpu, Z_FLAG, false); return 4; } //RLCA
-        case 0x08: { memory_write16(cpu->bus, cpu_fetch_word_pc(cpu), cpu->SP); return 20; } //LD (a16), SP
-        case 0x09: { instr_add16(cpu, cpu->BC.r16); return 8; } //ADD HL, BC
-        case 0x0A: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->BC.r16); return 8; } //LD A, (BC)
-        case 0x0B: { instr_dec16(&cpu->BC.r16); return 8; } //DEC BC
-        case 0x0C: { cpu->BC.r8.lo = instr_inc8(cpu, cpu->BC.r8.lo); return 4; } //INC C
-        case 0x0D: { cpu->BC.r8.lo = instr_dec8(cpu, cpu->BC.r8.lo); return 4; } //DEC C
-        case 0x0E: { cpu->BC.r8.lo = cpu_fetch_byte_pc(cpu); return 8; } //LD C, n8
-        case 0x0F: {cpu->AF.r8.hi = instr_rrc(cpu, cpu->AF.r8.hi); cpu_updateFlag(cpu, Z_FLAG, false); return 4; } //RRCA
-
-        case 0x10: { cpu_fetch_byte_pc(cpu); return 4; } //STOP
-        case 0x11: { cpu->DE.r16 = cpu_fetch_word_pc(cpu); return 12; } //LD DE, n16
-        case 0x12: { memory_write8(cpu->bus, cpu->DE.r16, cpu->AF.r8.hi); return 8; } //LD (DE), A
-        case 0x13: { instr_inc16(&cpu->DE.r16); return 8; } //INC DE
-        case 0x14: { cpu->DE.r8.hi = instr_inc8(cpu, cpu->DE.r8.hi); return 4; } //INC D
-        case 0x15: { cpu->DE.r8.hi = instr_dec8(cpu, cpu->DE.r8.hi); return 4; } //DEC D
-        case 0x16: { cpu->DE.r8.hi = cpu_fetch_byte_pc(cpu); return 8; } //LD D, n8
-        case 0x17: { cpu->AF.r8.hi = instr_rl(cpu, cpu->AF.r8.hi); cpu_updateFlag(cpu, Z_FLAG, false); return 4; } //RLA
-        case 0x18: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); instr_jr(cpu, e8); return 12; } //JR e8
-        case 0x19: { instr_add16(cpu, cpu->DE.r16); return 8; } //ADD HL, DE
-        case 0x1A: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->DE.r16); return 8; } //LD A, (DE)
-        case 0x1B: { instr_dec16(&cpu->DE.r16); return 8; } //DEC DE
-        case 0x1C: { cpu->DE.r8.lo = instr_inc8(cpu, cpu->DE.r8.lo); return 4; } //INC E
-        case 0x1D: { cpu->DE.r8.lo = instr_dec8(cpu, cpu->DE.r8.lo); return 4; } //DEC E
-        case 0x1E: { cpu->DE.r8.lo = cpu_fetch_byte_pc(cpu); return 8; } //LD E, n8
-        case 0x1F: { cpu->AF.r8.hi = instr_rr(cpu, cpu->AF.r8.hi); cpu_updateFlag(cpu, Z_FLAG, false); return 4; } //RRA
-
-        case 0x20: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 0) { instr_jr(cpu, e8); return 12; } else { return 8; }} //JR NZ, e8
-        case 0x21: { cpu->HL.r16 = cpu_fetch_word_pc(cpu); return 12; } //LD HL, n16
-        case 0x22: { memory_write8(cpu->bus, cpu->HL.r16, cpu->AF.r8.hi); cpu->HL.r16++; return 8; } //LD (HL+), A
-        case 0x23: { instr_inc16(&cpu->HL.r16); return 8; } //INC HL
-        case 0x24: { cpu->HL.r8.hi = instr_inc8(cpu, cpu->HL.r8.hi); return 4; } //INC H
-        case 0x25: { cpu->HL.r8.hi = instr_dec8(cpu, cpu->HL.r8.hi); return 4; } //DEC H
-        case 0x26: { cpu->HL.r8.hi = cpu_fetch_byte_pc(cpu); return 8; } //LD H, n8
-        case 0x27: { instr_daa(cpu); return 4; } //DAA
-        case 0x28: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 1) { instr_jr(cpu, e8); return 12; } else { return 8; }} //JR Z, e8
-
-        case 0x29: { instr_add16(cpu, cpu->HL.r16); return 8; } //ADD HL, HL
-        case 0x2A: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); cpu->HL.r16++; return 8; } //LD A, (HL+)
-        case 0x2B: { instr_dec16(&cpu->HL.r16); return 8; } //DEC HL
-        case 0x2C: { cpu->HL.r8.lo = instr_inc8(cpu, cpu->HL.r8.lo); return 4; } //INC L
-        case 0x2D: { cpu->HL.r8.lo = instr_dec8(cpu, cpu->HL.r8.lo); return 4; } //DEC L
-        case 0x2E: { cpu->HL.r8.lo = cpu_fetch_byte_pc(cpu); return 8; } //LD L, n8
-        case 0x2F: { instr_cpl(cpu); return 4; } //CPL
-
-        case 0x30: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 0) { instr_jr(cpu, e8); return 12; } else { return 8; }} //JR NC, e8
-        case 0x31: { cpu->SP = cpu_fetch_word_pc(cpu); return 12; } //LD SP, n16
-        case 0x32: { memory_write8(cpu->bus, cpu->HL.r16, cpu->AF.r8.hi); cpu->HL.r16--; return 8; } //LD (HL-), A
-        case 0x33: { instr_inc16(&cpu->SP); return 8; } //INC SP
-        case 0x34: { memory_write8(cpu->bus, cpu->HL.r16, instr_inc8(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 12; } //INC (HL)
-        case 0x35: { memory_write8(cpu->bus, cpu->HL.r16, instr_dec8(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 12; } //DEC (HL)
-        case 0x36: { memory_write8(cpu->bus, cpu->HL.r16, cpu_fetch_byte_pc(cpu)); return 12; } //LD (HL), n8
-        case 0x37: { instr_scf(cpu); return 4; } //SCF
-        case 0x38: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 1) { instr_jr(cpu, e8); return 12; } else { return 8; }} //JR C, e8
-        case 0x39: { instr_add16(cpu, cpu->SP); return 8; } //ADD HL, SP
-        case 0x3A: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); cpu->HL.r16--; return 8; } //LD A, (HL-)
-        case 0x3B: { instr_dec16(&cpu->SP); return 8; } //DEC SP
-        case 0x3C: { cpu->AF.r8.hi = instr_inc8(cpu, cpu->AF.r8.hi); return 4; } //INC A
-        case 0x3D: { cpu->AF.r8.hi = instr_dec8(cpu, cpu->AF.r8.hi); return 4; } //DEC A
-        case 0x3E: { cpu->AF.r8.hi = cpu_fetch_byte_pc(cpu); return 8; }; //LD A, n8
-        case 0x3F: { instr_ccf(cpu); return 4; } //CCF
-
-        case 0x40:  { cpu->BC.r8.hi = cpu->BC.r8.hi; return 4; } //LD B, B
-        case 0x41:  { cpu->BC.r8.hi = cpu->BC.r8.lo; return 4; } //LD B, C
-        case 0x42:  { cpu->BC.r8.hi = cpu->DE.r8.hi; return 4; } //LD B, D
-        case 0x43:  { cpu->BC.r8.hi = cpu->DE.r8.lo; return 4; } //LD B, E
-        case 0x44:  { cpu->BC.r8.hi = cpu->HL.r8.hi; return 4; } //LD B, H
-        case 0x45:  { cpu->BC.r8.hi = cpu->HL.r8.lo; return 4; } //LD B, L
-        case 0x46:  { cpu->BC.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD B, (HL)
-        case 0x47:  { cpu->BC.r8.hi = cpu->AF.r8.hi; return 4; } //LD B, A
-        case 0x48:  { cpu->BC.r8.lo = cpu->BC.r8.hi; return 4; } //LD C, B
-        case 0x49:  { cpu->BC.r8.lo = cpu->BC.r8.lo; return 4; } //LD C, C
-        case 0x4A:  { cpu->BC.r8.lo = cpu->DE.r8.hi; return 4; } //LD C, D
-        case 0x4B:  { cpu->BC.r8.lo = cpu->DE.r8.lo; return 4; } //LD C, E
-        case 0x4C:  { cpu->BC.r8.lo = cpu->HL.r8.hi; return 4; } //LD C, H
-        case 0x4D:  { cpu->BC.r8.lo = cpu->HL.r8.lo; return 4; } //LD C, L
-        case 0x4E:  { cpu->BC.r8.lo = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD C, (HL)
-        case 0x4F:  { cpu->BC.r8.lo = cpu->AF.r8.hi; return 4; } //LD C, A
-
-        case 0x50: { cpu->DE.r8.hi = cpu->BC.r8.hi; return 4; } //LD D, B
-        case 0x51: { cpu->DE.r8.hi = cpu->BC.r8.lo; return 4; } //LD D, C
-        case 0x52: { cpu->DE.r8.hi = cpu->DE.r8.hi; return 4; } //LD D, D
-        case 0x53: { cpu->DE.r8.hi = cpu->DE.r8.lo; return 4; } //LD D, E
-        case 0x54: { cpu->DE.r8.hi = cpu->HL.r8.hi; return 4; } //LD D, H
-        case 0x55: { cpu->DE.r8.hi = cpu->HL.r8.lo; return 4; } //LD D, L
-        case 0x56: { cpu->DE.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD D, (HL)
-        case 0x57: { cpu->DE.r8.hi = cpu->AF.r8.hi; return 4; } //LD D, A
-        case 0x58: { cpu->DE.r8.lo = cpu->BC.r8.hi; return 4; } //LD E, B
-        case 0x59: { cpu->DE.r8.lo = cpu->BC.r8.lo; return 4; } //LD E, C
-        case 0x5A: { cpu->DE.r8.lo = cpu->DE.r8.hi; return 4; } //LD E, D
-        case 0x5B: { cpu->DE.r8.lo = cpu->DE.r8.lo; return 4; } //LD E, E
-        case 0x5C: { cpu->DE.r8.lo = cpu->HL.r8.hi; return 4; } //LD E, H
-        case 0x5D: { cpu->DE.r8.lo = cpu->HL.r8.lo; return 4; } //LD E, L
-        case 0x5E: { cpu->DE.r8.lo = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD E, (HL)
-        case 0x5F: { cpu->DE.r8.lo = cpu->AF.r8.hi; return 4; } //LD E, A
-
-        case 0x60: { cpu->HL.r8.hi = cpu->BC.r8.hi; return 4; } //LD H, B
-        case 0x61: { cpu->HL.r8.hi = cpu->BC.r8.lo; return 4; } //LD H, C
-        case 0x62: { cpu->HL.r8.hi = cpu->DE.r8.hi; return 4; } //LD H, D
-        case 0x63: { cpu->HL.r8.hi = cpu->DE.r8.lo; return 4; } //LD H, E
-        case 0x64: { cpu->HL.r8.hi = cpu->HL.r8.hi; return 4; } //LD H, H
-        case 0x65: { cpu->HL.r8.hi = cpu->HL.r8.lo; return 4; } //LD H, L
-        case 0x66: { cpu->HL.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD H, (HL)
-        case 0x67: { cpu->HL.r8.hi = cpu->AF.r8.hi; return 4; } //LD H, A
-        case 0x68: { cpu->HL.r8.lo = cpu->BC.r8.hi; return 4; } //LD L, B
-        case 0x69: { cpu->HL.r8.lo = cpu->BC.r8.lo; return 4; } //LD L, C
-        case 0x6A: { cpu->HL.r8.lo = cpu->DE.r8.hi; return 4; } //LD L, D
-        case 0x6B: { cpu->HL.r8.lo = cpu->DE.r8.lo; return 4; } //LD L, E
-        case 0x6C: { cpu->HL.r8.lo = cpu->HL.r8.hi; return 4; } //LD L, H
-        case 0x6D: { cpu->HL.r8.lo = cpu->HL.r8.lo; return 4; } //LD L, L
-        case 0x6E: { cpu->HL.r8.lo = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD L, (HL)
-        case 0x6F: { cpu->HL.r8.lo = cpu->AF.r8.hi; return 4; } //LD L, A
-
-        case 0x70: { memory_write8(cpu->bus, cpu->HL.r16, cpu->BC.r8.hi); return 8; } //LD (HL), B
-        case 0x71: { memory_write8(cpu->bus, cpu->HL.r16, cpu->BC.r8.lo); return 8; } //LD (HL), C
-        case 0x72: { memory_write8(cpu->bus, cpu->HL.r16, cpu->DE.r8.hi); return 8; } //LD (HL), D
-        case 0x73: { memory_write8(cpu->bus, cpu->HL.r16, cpu->DE.r8.lo); return 8; } //LD (HL), E
-        case 0x74: { memory_write8(cpu->bus, cpu->HL.r16, cpu->HL.r8.hi); return 8; } //LD (HL), H
-        case 0x75: { memory_write8(cpu->bus, cpu->HL.r16, cpu->HL.r8.lo); return 8; } //LD (HL), L
-        case 0x76: { cpu->is_HALT = true; return 4; } //HALT
-        case 0x77: { memory_write8(cpu->bus, cpu->HL.r16, cpu->AF.r8.hi); return 8; } //LD (HL), A
-        case 0x78: { cpu->AF.r8.hi = cpu->BC.r8.hi; return 4; } //LD A, B
-        case 0x79: { cpu->AF.r8.hi = cpu->BC.r8.lo; return 4; } //LD A, C
-        case 0x7A: { cpu->AF.r8.hi = cpu->DE.r8.hi; return 4; } //LD A, D
-        case 0x7B: { cpu->AF.r8.hi = cpu->DE.r8.lo; return 4; } //LD A, E
-        case 0x7C: { cpu->AF.r8.hi = cpu->HL.r8.hi; return 4; } //LD A, H
-        case 0x7D: { cpu->AF.r8.hi = cpu->HL.r8.lo; return 4; } //LD A, L
-        case 0x7E: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu->HL.r16); return 8; } //LD A, (HL)
-        case 0x7F: { cpu->AF.r8.hi = cpu->AF.r8.hi; return 4; } //LD A, A
-
-        case 0x80: { instr_add8(cpu, cpu->BC.r8.hi); return 4; } //ADD A, B
-        case 0x81: { instr_add8(cpu, cpu->BC.r8.lo); return 4; } //ADD A, C
-        case 0x82: { instr_add8(cpu, cpu->DE.r8.hi); return 4; } //ADD A, D
-        case 0x83: { instr_add8(cpu, cpu->DE.r8.lo); return 4; } //ADD A, E
-        case 0x84: { instr_add8(cpu, cpu->HL.r8.hi); return 4; } //ADD A, H
-        case 0x85: { instr_add8(cpu, cpu->HL.r8.lo); return 4; } //ADD A, L
-        case 0x86: { instr_add8(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //ADD A, (HL)
-        case 0x87: { instr_add8(cpu, cpu->AF.r8.hi); return 4; } //ADD A, A
-        case 0x88: { instr_adc(cpu, cpu->BC.r8.hi); return 4; } //ADC A, B
-        case 0x89: { instr_adc(cpu, cpu->BC.r8.lo); return 4; } //ADC A, C
-        case 0x8A: { instr_adc(cpu, cpu->DE.r8.hi); return 4; } //ADC A, D
-        case 0x8B: { instr_adc(cpu, cpu->DE.r8.lo); return 4; } //ADC A, E
-        case 0x8C: { instr_adc(cpu, cpu->HL.r8.hi); return 4; } //ADC A, H
-        case 0x8D: { instr_adc(cpu, cpu->HL.r8.lo); return 4; } //ADC A, L
-        case 0x8E: { instr_adc(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //ADC A, (HL)
-        case 0x8F: { instr_adc(cpu, cpu->AF.r8.hi); return 4; } //ADC A, A
-
-        case 0x90: { instr_sub(cpu, cpu->BC.r8.hi); return 4; } //SUB A, B
-        case 0x91: { instr_sub(cpu, cpu->BC.r8.lo); return 4; } //SUB A, C
-        case 0x92: { instr_sub(cpu, cpu->DE.r8.hi); return 4; } //SUB A, D
-        case 0x93: { instr_sub(cpu, cpu->DE.r8.lo); return 4; } //SUB A, E
-        case 0x94: { instr_sub(cpu, cpu->HL.r8.hi); return 4; } //SUB A, H
-        case 0x95: { instr_sub(cpu, cpu->HL.r8.lo); return 4; } //SUB A, L
-        case 0x96: { instr_sub(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //SUB A, (HL)
-        case 0x97: { instr_sub(cpu, cpu->AF.r8.hi); return 4; } //SUB A, A
-        case 0x98: { instr_sbc(cpu, cpu->BC.r8.hi); return 4; } //SBC A, B
-        case 0x99: { instr_sbc(cpu, cpu->BC.r8.lo); return 4; } //SBC A, C
-        case 0x9A: { instr_sbc(cpu, cpu->DE.r8.hi); return 4; } //SBC A, D
-        case 0x9B: { instr_sbc(cpu, cpu->DE.r8.lo); return 4; } //SBC A, E
-        case 0x9C: { instr_sbc(cpu, cpu->HL.r8.hi); return 4; } //SBC A, H
-        case 0x9D: { instr_sbc(cpu, cpu->HL.r8.lo); return 4; } //SBC A, L
-        case 0x9E: { instr_sbc(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //SBC A, (HL)
-        case 0x9F: { instr_sbc(cpu, cpu->AF.r8.hi); return 4; } //SBC A, A
-
-        case 0xA0: { instr_and(cpu, cpu->BC.r8.hi); return 4; } //AND A, B
-        case 0xA1: { instr_and(cpu, cpu->BC.r8.lo); return 4; } //AND A, C
-        case 0xA2: { instr_and(cpu, cpu->DE.r8.hi); return 4; } //AND A, D
-        case 0xA3: { instr_and(cpu, cpu->DE.r8.lo); return 4; } //AND A, E
-        case 0xA4: { instr_and(cpu, cpu->HL.r8.hi); return 4; } //AND A, H
-        case 0xA5: { instr_and(cpu, cpu->HL.r8.lo); return 4; } //AND A, L
-        case 0xA6: { instr_and(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //AND A, (HL)
-        case 0xA7: { instr_and(cpu, cpu->AF.r8.hi); return 4; } //AND A, A
-        case 0xA8: { instr_xor(cpu, cpu->BC.r8.hi); return 4; } //XOR A, B
-        case 0xA9: { instr_xor(cpu, cpu->BC.r8.lo); return 4; } //XOR A, C
-        case 0xAA: { instr_xor(cpu, cpu->DE.r8.hi); return 4; } //XOR A, D
-        case 0xAB: { instr_xor(cpu, cpu->DE.r8.lo); return 4; } //XOR A, E
-        case 0xAC: { instr_xor(cpu, cpu->HL.r8.hi); return 4; } //XOR A, H
-        case 0xAD: { instr_xor(cpu, cpu->HL.r8.lo); return 4; } //XOR A, L
-        case 0xAE: { instr_xor(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //XOR A, (HL)
-        case 0xAF: { instr_xor(cpu, cpu->AF.r8.hi); return 4; } //XOR A, A
-
-        case 0xB0: { instr_or(cpu, cpu->BC.r8.hi); return 4; } //OR A, B
-        case 0xB1: { instr_or(cpu, cpu->BC.r8.lo); return 4; } //OR A, C
-        case 0xB2: { instr_or(cpu, cpu->DE.r8.hi); return 4; } //OR A, D
-        case 0xB3: { instr_or(cpu, cpu->DE.r8.lo); return 4; } //OR A, E
-        case 0xB4: { instr_or(cpu, cpu->HL.r8.hi); return 4; } //OR A, H
-        case 0xB5: { instr_or(cpu, cpu->HL.r8.lo); return 4; } //OR A, L
-        case 0xB6: { instr_or(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //OR A, (HL)
-        case 0xB7: { instr_or(cpu, cpu->AF.r8.hi); return 4; } //OR A, A
-        case 0xB8: { instr_cp(cpu, cpu->BC.r8.hi); return 4; } //CP A, B
-        case 0xB9: { instr_cp(cpu, cpu->BC.r8.lo); return 4; } //CP A, C
-        case 0xBA: { instr_cp(cpu, cpu->DE.r8.hi); return 4; } //CP A, D
-        case 0xBB: { instr_cp(cpu, cpu->DE.r8.lo); return 4; } //CP A, E
-        case 0xBC: { instr_cp(cpu, cpu->HL.r8.hi); return 4; } //CP A, H
-        case 0xBD: { instr_cp(cpu, cpu->HL.r8.lo); return 4; } //CP A, L
-        case 0xBE: { instr_cp(cpu, memory_read8(cpu->bus, cpu->HL.r16)); return 8; } //CP A, (HL)
-        case 0xBF: { instr_cp(cpu, cpu->AF.r8.hi); return 4; } //CP A, A
-
-        case 0xC0: { if (cpu_getFlag(cpu, Z_FLAG) == 0) { cpu->PC = instr_pop(cpu); return 20; } else { return 8; } } //RET NZ
-        case 0xC1: { cpu->BC.r16 = instr_pop(cpu); return 12; } //POP BC
-        case 0xC2: {uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 0) { cpu->PC = a16; return 16; } else { return 12; }} //JP NZ, a16 (else, pc, is already move to next instr)
-        case 0xC3: { cpu->PC = cpu_fetch_word_pc(cpu); return 16; } //JP a16
-        case 0xC4: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 0) {instr_push(cpu, cpu->PC); cpu->PC = a16; return 24; } else { return 12; }} //CALL NZ, a16
-        case 0xC5: { instr_push(cpu, cpu->BC.r16); return 16; } //PUSH BC
-        case 0xC6: { instr_add8(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //ADD A, n8
-        case 0xC7: { instr_push(cpu, cpu->PC); cpu->PC = 0x0000; return 16; } //RST $00
-        case 0xC8: { if (cpu_getFlag(cpu, Z_FLAG) == 1) { cpu->PC = instr_pop(cpu); return 20; } else { return 8; } } //RET Z
-        case 0xC9: { cpu->PC = instr_pop(cpu); return 16; } //RET
-        case 0xCA: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 1) { cpu->PC = a16; return 16; } else { return 12; }} //JP Z, a16
-        case 0xCB: { uint8_t opcb = cpu_fetch_byte_pc(cpu); return cpu_execute_instruction_CB(cpu, opcb); } //PREFIX CB
-        case 0xCC: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, Z_FLAG) == 1) {instr_push(cpu, cpu->PC); cpu->PC = a16; return 24; } else { return 12; }} //CALL Z, a16
-        case 0xCD: { uint16_t a16 = cpu_fetch_word_pc(cpu); instr_push(cpu, cpu->PC); cpu->PC = a16; return 24; } //CALL a16
-        case 0xCE: { instr_adc(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //ADC A, n8
-        case 0xCF: { instr_push(cpu, cpu->PC); cpu->PC = 0x0008; return 16; } //RST $08
-
-        case 0xD0: { if (cpu_getFlag(cpu, C_FLAG) == 0) { cpu->PC = instr_pop(cpu); return 20; } else { return 8; } } //RET NC
-        case 0xD1: { cpu->DE.r16 = instr_pop(cpu); return 12; } //POP DE
-        case 0xD2: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 0) { cpu->PC = a16; return 16; } else { return 12; }} //JP NC, a16
-        case 0xD4: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 0) { instr_push(cpu, cpu->PC); cpu->PC = a16; return 24; } else { return 12; }} //CALL NC, a16
-        case 0xD5: { instr_push(cpu, cpu->DE.r16); return 16; } //PUSH DE
-        case 0xD6: { instr_sub(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //SUB A, n8
-        case 0xD7: { instr_push(cpu, cpu->PC); cpu->PC = 0x0010; return 16; } //RST $10
-        case 0xD8: { if (cpu_getFlag(cpu, C_FLAG) == 1) { cpu->PC = instr_pop(cpu); return 20; } else { return 8; } } //RET C
-        case 0xD9: { cpu->IME = true; cpu->PC = instr_pop(cpu); return 16; } //RETI (no delay time like ei to enable IME)
-        case 0xDA: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 1) { cpu->PC = a16; return 16; } else { return 12; }} //JP C, a16
-        case 0xDC: { uint16_t a16 = cpu_fetch_word_pc(cpu); if (cpu_getFlag(cpu, C_FLAG) == 1) { instr_push(cpu, cpu->PC); cpu->PC = a16; return 24; } else { return 12; }} //CALL C, a16
-        case 0xDE: { instr_sbc(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //SBC A, n8
-        case 0xDF: { instr_push(cpu, cpu->PC); cpu->PC = 0x0018; return 16; } //RST $18
-
-        case 0xE0: { memory_write8(cpu->bus, (0xFF00 + cpu_fetch_byte_pc(cpu)), cpu->AF.r8.hi); return 12; } //LDH (a8), A
-        case 0xE1: { cpu->HL.r16 = instr_pop(cpu); return 12; } //POP HL
-        case 0xE2: { memory_write8(cpu->bus, (0xFF00 + cpu->BC.r8.lo), cpu->AF.r8.hi); return 8; } //LD (C), A
-        case 0xE5: { instr_push(cpu, cpu->HL.r16); return 16; } //PUSH HL
-        case 0xE6: { instr_and(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //AND A, n8
-        case 0xE7: { instr_push(cpu, cpu->PC); cpu->PC = 0x0020; return 16; } //RST $20
-        case 0xE8: {int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); cpu->SP = instr_add16imm(cpu, e8); return 16; }; //ADD SP, e8
-        case 0xE9: { cpu->PC = cpu->HL.r16; return 4; } //JP HL
-        case 0xEA: { memory_write8(cpu->bus, cpu_fetch_word_pc(cpu), cpu->AF.r8.hi); return 16; } //LD (a16), A
-        case 0xEE: { instr_xor(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //XOR A, n8
-        case 0xEF: { instr_push(cpu, cpu->PC); cpu->PC = 0x0028; return 16; } //RST $28
-
-        case 0xF0: { cpu->AF.r8.hi = memory_read8(cpu->bus, (0xFF00 + cpu_fetch_byte_pc(cpu))); return 12; } //LDH A, (n8)
-        case 0xF1: { cpu->AF.r16 = instr_pop(cpu) & 0xFFF0; return 12; } //POP AF (set 4low bits to 0)
-        case 0xF2: { cpu->AF.r8.hi = memory_read8(cpu->bus, (0xFF00 + cpu->BC.r8.lo)); return 8; } //LD A, (C)
-        case 0xF3: { cpu->di_delay = 2; return 4; } //DI
-        case 0xF5: { instr_push(cpu, cpu->AF.r16); return 16; } //PUSH AF
-        case 0xF6: { instr_or(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //OR A, n8
-        case 0xF7: { instr_push(cpu, cpu->PC); cpu->PC = 0x0030; return 16; } //RST 0x30
-        case 0xF8: { int8_t e8 = (int8_t)cpu_fetch_byte_pc(cpu); cpu->HL.r16 = instr_add16imm(cpu, e8); return 12; } //LD HL, SP + e8
-        case 0xF9: { cpu->SP = cpu->HL.r16; return 8; } //LD SP, HL
-        case 0xFA: { cpu->AF.r8.hi = memory_read8(cpu->bus, cpu_fetch_word_pc(cpu)); return 16; } //LD A, (a16)
-        case 0xFB: { cpu->ei_delay = 2; return 4; } //EI
-        case 0xFE: { instr_cp(cpu, cpu_fetch_byte_pc(cpu)); return 8; } //CP A, n8
-        case 0xFF: { instr_push(cpu, cpu->PC); cpu->PC = 0x0038; return 16; } //RST $38
-
-        default: { fprintf(stderr, "[ERROR] : ILLEGAL INSTRUCTION"); abort(); }
+
+    const Opcode* op = &opcode_table[opcode];
+    uint16_t operand = 0;
+
+    switch (op->length) {
+        case 2: { operand = cpu_fetch_byte_pc(cpu); break; }
+        case 3: { operand = cpu_fetch_word_pc(cpu); break; }
+        default: { break; }
     }
+
+    return op->handler(cpu, opcode, operand);
 }
 
 uint32_t cpu_execute_instruction_CB(Cpu* cpu, uint8_t opcode)
@@ -468,280 +970,5 @@ uint32_t cpu_execute_instruction_CB(Cpu* cpu, uint8_t opcode)
     if (!cpu)
         abort();
 
-    switch (opcode) {
-       case 0x00: { cpu->BC.r8.hi = instr_rlc(cpu, cpu->BC.r8.hi); return 8; } //RLC B
-       case 0x01: { cpu->BC.r8.lo = instr_rlc(cpu, cpu->BC.r8.lo); return 8; } //RLC C
-       case 0x02: { cpu->DE.r8.hi = instr_rlc(cpu, cpu->DE.r8.hi); return 8; } //RLC D
-       case 0x03: { cpu->DE.r8.lo = instr_rlc(cpu, cpu->DE.r8.lo); return 8; } //RLC E
-       case 0x04: { cpu->HL.r8.hi = instr_rlc(cpu, cpu->HL.r8.hi); return 8; } //RLC H
-       case 0x05: { cpu->HL.r8.lo = instr_rlc(cpu, cpu->HL.r8.lo); return 8; } //RLC L
-       case 0x06: { memory_write8(cpu->bus, cpu->HL.r16, instr_rlc(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RLC (HL)
-       case 0x07: { cpu->AF.r8.hi = instr_rlc(cpu, cpu->AF.r8.hi); return 8; } //RLC A
-       case 0x08: { cpu->BC.r8.hi = instr_rrc(cpu, cpu->BC.r8.hi); return 8; } //RRC B
-       case 0x09: { cpu->BC.r8.lo = instr_rrc(cpu, cpu->BC.r8.lo); return 8; } //RRC C
-       case 0x0A: { cpu->DE.r8.hi = instr_rrc(cpu, cpu->DE.r8.hi); return 8; } //RRC D
-       case 0x0B: { cpu->DE.r8.lo = instr_rrc(cpu, cpu->DE.r8.lo); return 8; } //RRC E
-       case 0x0C: { cpu->HL.r8.hi = instr_rrc(cpu, cpu->HL.r8.hi); return 8; } //RRC H
-       case 0x0D: { cpu->HL.r8.lo = instr_rrc(cpu, cpu->HL.r8.lo); return 8; } //RRC L
-       case 0x0E: { memory_write8(cpu->bus, cpu->HL.r16, instr_rrc(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RRC (HL)
-       case 0x0F: { cpu->AF.r8.hi = instr_rrc(cpu, cpu->AF.r8.hi); return 8; } //RRC A
-
-       case 0x10: { cpu->BC.r8.hi = instr_rl(cpu, cpu->BC.r8.hi); return 8; } //RL B
-       case 0x11: { cpu->BC.r8.lo = instr_rl(cpu, cpu->BC.r8.lo); return 8; } //RL C
-       case 0x12: { cpu->DE.r8.hi = instr_rl(cpu, cpu->DE.r8.hi); return 8; } //RL D
-       case 0x13: { cpu->DE.r8.lo = instr_rl(cpu, cpu->DE.r8.lo); return 8; } //RL E
-       case 0x14: { cpu->HL.r8.hi = instr_rl(cpu, cpu->HL.r8.hi); return 8; } //RL H
-       case 0x15: { cpu->HL.r8.lo = instr_rl(cpu, cpu->HL.r8.lo); return 8; } //RL L
-       case 0x16: { memory_write8(cpu->bus, cpu->HL.r16, instr_rl(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RL (HL)
-       case 0x17: { cpu->AF.r8.hi = instr_rl(cpu, cpu->AF.r8.hi); return 8; } //RL A
-       case 0x18: { cpu->BC.r8.hi = instr_rr(cpu, cpu->BC.r8.hi); return 8; } //RR B
-       case 0x19: { cpu->BC.r8.lo = instr_rr(cpu, cpu->BC.r8.lo); return 8; } //RR C
-       case 0x1A: { cpu->DE.r8.hi = instr_rr(cpu, cpu->DE.r8.hi); return 8; } //RR D
-       case 0x1B: { cpu->DE.r8.lo = instr_rr(cpu, cpu->DE.r8.lo); return 8; } //RR E
-       case 0x1C: { cpu->HL.r8.hi = instr_rr(cpu, cpu->HL.r8.hi); return 8; } //RR H
-       case 0x1D: { cpu->HL.r8.lo = instr_rr(cpu, cpu->HL.r8.lo); return 8; } //RR L
-       case 0x1E: { memory_write8(cpu->bus, cpu->HL.r16, instr_rr(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RR (HL)
-       case 0x1F: { cpu->AF.r8.hi = instr_rr(cpu, cpu->AF.r8.hi); return 8; } //RR A
-
-       case 0x20:{ cpu->BC.r8.hi = instr_sla(cpu, cpu->BC.r8.hi); return 8; } //SLA B
-       case 0x21:{ cpu->BC.r8.lo = instr_sla(cpu, cpu->BC.r8.lo); return 8; } //SLA C
-       case 0x22:{ cpu->DE.r8.hi = instr_sla(cpu, cpu->DE.r8.hi); return 8; } //SLA D
-       case 0x23:{ cpu->DE.r8.lo = instr_sla(cpu, cpu->DE.r8.lo); return 8; } //SLA E
-       case 0x24:{ cpu->HL.r8.hi = instr_sla(cpu, cpu->HL.r8.hi); return 8; } //SLA H
-       case 0x25:{ cpu->HL.r8.lo = instr_sla(cpu, cpu->HL.r8.lo); return 8; } //SLA L
-       case 0x26:{ memory_write8(cpu->bus, cpu->HL.r16, instr_sla(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SLA (HL)
-       case 0x27:{ cpu->AF.r8.hi = instr_sla(cpu, cpu->AF.r8.hi); return 8; } //SLA A
-       case 0x28: { cpu->BC.r8.hi = instr_sra(cpu, cpu->BC.r8.hi); return 8; } //SRA B
-       case 0x29: { cpu->BC.r8.lo = instr_sra(cpu, cpu->BC.r8.lo); return 8; } //SRA C
-       case 0x2A: { cpu->DE.r8.hi = instr_sra(cpu, cpu->DE.r8.hi); return 8; } //SRA D
-       case 0x2B: { cpu->DE.r8.lo = instr_sra(cpu, cpu->DE.r8.lo); return 8; } //SRA E
-       case 0x2C: { cpu->HL.r8.hi = instr_sra(cpu, cpu->HL.r8.hi); return 8; } //SRA H
-       case 0x2D: { cpu->HL.r8.lo = instr_sra(cpu, cpu->HL.r8.lo); return 8; } //SRA L
-       case 0x2E: { memory_write8(cpu->bus, cpu->HL.r16, instr_sra(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SRA (HL)
-       case 0x2F: { cpu->AF.r8.hi = instr_sra(cpu, cpu->AF.r8.hi); return 8; } //SRA A
-
-       case 0x30: { cpu->BC.r8.hi = instr_swap(cpu, cpu->BC.r8.hi); return 8; } //SWAP B
-       case 0x31: { cpu->BC.r8.lo = instr_swap(cpu, cpu->BC.r8.lo); return 8; } //SWAP C
-       case 0x32: { cpu->DE.r8.hi = instr_swap(cpu, cpu->DE.r8.hi); return 8; } //SWAP D
-       case 0x33: { cpu->DE.r8.lo = instr_swap(cpu, cpu->DE.r8.lo); return 8; } //SWAP E
-       case 0x34: { cpu->HL.r8.hi = instr_swap(cpu, cpu->HL.r8.hi); return 8; } //SWAP H
-       case 0x35: { cpu->HL.r8.lo = instr_swap(cpu, cpu->HL.r8.lo); return 8; } //SWAP L
-       case 0x36: { memory_write8(cpu->bus, cpu->HL.r16, instr_swap(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SWAP (HL)
-       case 0x37: { cpu->AF.r8.hi = instr_swap(cpu, cpu->AF.r8.hi); return 8; } //SWAP A
-       case 0x38: { cpu->BC.r8.hi = instr_srl(cpu, cpu->BC.r8.hi); return 8; } //SRL B
-       case 0x39: { cpu->BC.r8.lo = instr_srl(cpu, cpu->BC.r8.lo); return 8; } //SRL C
-       case 0x3A: { cpu->DE.r8.hi = instr_srl(cpu, cpu->DE.r8.hi); return 8; } //SRL D
-       case 0x3B: { cpu->DE.r8.lo = instr_srl(cpu, cpu->DE.r8.lo); return 8; } //SRL E
-       case 0x3C: { cpu->HL.r8.hi = instr_srl(cpu, cpu->HL.r8.hi); return 8; } //SRL H
-       case 0x3D: { cpu->HL.r8.lo = instr_srl(cpu, cpu->HL.r8.lo); return 8; } //SRL L
-       case 0x3E: { memory_write8(cpu->bus, cpu->HL.r16, instr_srl(cpu, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SRL (HL)
-       case 0x3F: { cpu->AF.r8.hi = instr_srl(cpu, cpu->AF.r8.hi); return 8; } //SRL A
-
-       case 0x40: { instr_bit(cpu, 0, cpu->BC.r8.hi); return 8; } //BIT 0, B
-       case 0x41: { instr_bit(cpu, 0, cpu->BC.r8.lo); return 8; } //BIT 0, C
-       case 0x42: { instr_bit(cpu, 0, cpu->DE.r8.hi); return 8; } //BIT 0, D
-       case 0x43: { instr_bit(cpu, 0, cpu->DE.r8.lo); return 8; } //BIT 0, E
-       case 0x44: { instr_bit(cpu, 0, cpu->HL.r8.hi); return 8; } //BIT 0, H
-       case 0x45: { instr_bit(cpu, 0, cpu->HL.r8.lo); return 8; } //BIT 0, L
-       case 0x46: { instr_bit(cpu, 0, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 0, (HL)
-       case 0x47: { instr_bit(cpu, 0, cpu->AF.r8.hi); return 8; } //BIT 0, A
-       case 0x48: { instr_bit(cpu, 1, cpu->BC.r8.hi); return 8; } //BIT 1, B
-       case 0x49: { instr_bit(cpu, 1, cpu->BC.r8.lo); return 8; } //BIT 1, C
-       case 0x4A: { instr_bit(cpu, 1, cpu->DE.r8.hi); return 8; } //BIT 1, D
-       case 0x4B: { instr_bit(cpu, 1, cpu->DE.r8.lo); return 8; } //BIT 1, E
-       case 0x4C: { instr_bit(cpu, 1, cpu->HL.r8.hi); return 8; } //BIT 1, H
-       case 0x4D: { instr_bit(cpu, 1, cpu->HL.r8.lo); return 8; } //BIT 1, L
-       case 0x4E: { instr_bit(cpu, 1, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 1, (HL)
-       case 0x4F: { instr_bit(cpu, 1, cpu->AF.r8.hi); return 8; } //BIT 1, A
-
-       case 0x50: { instr_bit(cpu, 2, cpu->BC.r8.hi); return 8; } //BIT 2, B
-       case 0x51: { instr_bit(cpu, 2, cpu->BC.r8.lo); return 8; } //BIT 2, C
-       case 0x52: { instr_bit(cpu, 2, cpu->DE.r8.hi); return 8; } //BIT 2, D
-       case 0x53: { instr_bit(cpu, 2, cpu->DE.r8.lo); return 8; } //BIT 2, E
-       case 0x54: { instr_bit(cpu, 2, cpu->HL.r8.hi); return 8; } //BIT 2, H
-       case 0x55: { instr_bit(cpu, 2, cpu->HL.r8.lo); return 8; } //BIT 2, L
-       case 0x56: { instr_bit(cpu, 2, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 2, (HL)
-       case 0x57: { instr_bit(cpu, 2, cpu->AF.r8.hi); return 8; } //BIT 2, A
-       case 0x58: { instr_bit(cpu, 3, cpu->BC.r8.hi); return 8; } //BIT 3, B
-       case 0x59: { instr_bit(cpu, 3, cpu->BC.r8.lo); return 8; } //BIT 3, C
-       case 0x5A: { instr_bit(cpu, 3, cpu->DE.r8.hi); return 8; } //BIT 3, D
-       case 0x5B: { instr_bit(cpu, 3, cpu->DE.r8.lo); return 8; } //BIT 3, E
-       case 0x5C: { instr_bit(cpu, 3, cpu->HL.r8.hi); return 8; } //BIT 3, H
-       case 0x5D: { instr_bit(cpu, 3, cpu->HL.r8.lo); return 8; } //BIT 3, L
-       case 0x5E: { instr_bit(cpu, 3, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 3, (HL)
-       case 0x5F: { instr_bit(cpu, 3, cpu->AF.r8.hi); return 8; } //BIT 3, A
-
-       case 0x60: { instr_bit(cpu, 4, cpu->BC.r8.hi); return 8; } //BIT 4, B
-       case 0x61: { instr_bit(cpu, 4, cpu->BC.r8.lo); return 8; } //BIT 4, C
-       case 0x62: { instr_bit(cpu, 4, cpu->DE.r8.hi); return 8; } //BIT 4, D
-       case 0x63: { instr_bit(cpu, 4, cpu->DE.r8.lo); return 8; } //BIT 4, E
-       case 0x64: { instr_bit(cpu, 4, cpu->HL.r8.hi); return 8; } //BIT 4, H
-       case 0x65: { instr_bit(cpu, 4, cpu->HL.r8.lo); return 8; } //BIT 4, L
-       case 0x66: { instr_bit(cpu, 4, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 4, (HL)
-       case 0x67: { instr_bit(cpu, 4, cpu->AF.r8.hi); return 8; } //BIT 4, A
-       case 0x68: { instr_bit(cpu, 5, cpu->BC.r8.hi); return 8; } //BIT 5, B
-       case 0x69: { instr_bit(cpu, 5, cpu->BC.r8.lo); return 8; } //BIT 5, C
-       case 0x6A: { instr_bit(cpu, 5, cpu->DE.r8.hi); return 8; } //BIT 5, D
-       case 0x6B: { instr_bit(cpu, 5, cpu->DE.r8.lo); return 8; } //BIT 5, E
-       case 0x6C: { instr_bit(cpu, 5, cpu->HL.r8.hi); return 8; } //BIT 5, H
-       case 0x6D: { instr_bit(cpu, 5, cpu->HL.r8.lo); return 8; } //BIT 5, L
-       case 0x6E: { instr_bit(cpu, 5, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 5, (HL)
-       case 0x6F: { instr_bit(cpu, 5, cpu->AF.r8.hi); return 8; } //BIT 5, A
-
-       case 0x70: { instr_bit(cpu, 6, cpu->BC.r8.hi); return 8; } //BIT 6, B
-       case 0x71: { instr_bit(cpu, 6, cpu->BC.r8.lo); return 8; } //BIT 6, C
-       case 0x72: { instr_bit(cpu, 6, cpu->DE.r8.hi); return 8; } //BIT 6, D
-       case 0x73: { instr_bit(cpu, 6, cpu->DE.r8.lo); return 8; } //BIT 6, E
-       case 0x74: { instr_bit(cpu, 6, cpu->HL.r8.hi); return 8; } //BIT 6, H
-       case 0x75: { instr_bit(cpu, 6, cpu->HL.r8.lo); return 8; } //BIT 6, L
-       case 0x76: { instr_bit(cpu, 6, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 6, (HL)
-       case 0x77: { instr_bit(cpu, 6, cpu->AF.r8.hi); return 8; } //BIT 6, A
-       case 0x78: { instr_bit(cpu, 7, cpu->BC.r8.hi); return 8; } //BIT 7, B
-       case 0x79: { instr_bit(cpu, 7, cpu->BC.r8.lo); return 8; } //BIT 7, C
-       case 0x7A: { instr_bit(cpu, 7, cpu->DE.r8.hi); return 8; } //BIT 7, D
-       case 0x7B: { instr_bit(cpu, 7, cpu->DE.r8.lo); return 8; } //BIT 7, E
-       case 0x7C: { instr_bit(cpu, 7, cpu->HL.r8.hi); return 8; } //BIT 7, H
-       case 0x7D: { instr_bit(cpu, 7, cpu->HL.r8.lo); return 8; } //BIT 7, L
-       case 0x7E: { instr_bit(cpu, 7, memory_read8(cpu->bus, cpu->HL.r16)); return 12; } //BIT 7, (HL)
-       case 0x7F: { instr_bit(cpu, 7, cpu->AF.r8.hi); return 8; } //BIT 7, A
-
-       case 0x80: { cpu->BC.r8.hi = instr_res(0, cpu->BC.r8.hi); return 8; } //RES 0, B
-       case 0x81: { cpu->BC.r8.lo = instr_res(0, cpu->BC.r8.lo); return 8; } //RES 0, C
-       case 0x82: { cpu->DE.r8.hi = instr_res(0, cpu->DE.r8.hi); return 8; } //RES 0, D
-       case 0x83: { cpu->DE.r8.lo = instr_res(0, cpu->DE.r8.lo); return 8; } //RES 0, E
-       case 0x84: { cpu->HL.r8.hi = instr_res(0, cpu->HL.r8.hi); return 8; } //RES 0, H
-       case 0x85: { cpu->HL.r8.lo = instr_res(0, cpu->HL.r8.lo); return 8; } //RES 0, L
-       case 0x86: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(0, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 0, (HL)
-       case 0x87: { cpu->AF.r8.hi = instr_res(0, cpu->AF.r8.hi); return 8; } //RES 0, A
-       case 0x88: { cpu->BC.r8.hi = instr_res(1, cpu->BC.r8.hi); return 8; } //RES 1, B
-       case 0x89: { cpu->BC.r8.lo = instr_res(1, cpu->BC.r8.lo); return 8; } //RES 1, C
-       case 0x8A: { cpu->DE.r8.hi = instr_res(1, cpu->DE.r8.hi); return 8; } //RES 1, D
-       case 0x8B: { cpu->DE.r8.lo = instr_res(1, cpu->DE.r8.lo); return 8; } //RES 1, E
-       case 0x8C: { cpu->HL.r8.hi = instr_res(1, cpu->HL.r8.hi); return 8; } //RES 1, H
-       case 0x8D: { cpu->HL.r8.lo = instr_res(1, cpu->HL.r8.lo); return 8; } //RES 1, L
-       case 0x8E: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(1, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 1, (HL)
-       case 0x8F: { cpu->AF.r8.hi = instr_res(1, cpu->AF.r8.hi); return 8; } //RES 1, A
-
-       case 0x90: { cpu->BC.r8.hi = instr_res(2, cpu->BC.r8.hi); return 8; } //RES 2, B
-       case 0x91: { cpu->BC.r8.lo = instr_res(2, cpu->BC.r8.lo); return 8; } //RES 2, C
-       case 0x92: { cpu->DE.r8.hi = instr_res(2, cpu->DE.r8.hi); return 8; } //RES 2, D
-       case 0x93: { cpu->DE.r8.lo = instr_res(2, cpu->DE.r8.lo); return 8; } //RES 2, E
-       case 0x94: { cpu->HL.r8.hi = instr_res(2, cpu->HL.r8.hi); return 8; } //RES 2, H
-       case 0x95: { cpu->HL.r8.lo = instr_res(2, cpu->HL.r8.lo); return 8; } //RES 2, L
-       case 0x96: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(2, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 2, (HL)
-       case 0x97: { cpu->AF.r8.hi = instr_res(2, cpu->AF.r8.hi); return 8; } //RES 2, A
-       case 0x98: { cpu->BC.r8.hi = instr_res(3, cpu->BC.r8.hi); return 8; } //RES 3, B
-       case 0x99: { cpu->BC.r8.lo = instr_res(3, cpu->BC.r8.lo); return 8; } //RES 3, C
-       case 0x9A: { cpu->DE.r8.hi = instr_res(3, cpu->DE.r8.hi); return 8; } //RES 3, D
-       case 0x9B: { cpu->DE.r8.lo = instr_res(3, cpu->DE.r8.lo); return 8; } //RES 3, E
-       case 0x9C: { cpu->HL.r8.hi = instr_res(3, cpu->HL.r8.hi); return 8; } //RES 3, H
-       case 0x9D: { cpu->HL.r8.lo = instr_res(3, cpu->HL.r8.lo); return 8; } //RES 3, L
-       case 0x9E: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(3, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 3, (HL)
-       case 0x9F: { cpu->AF.r8.hi = instr_res(3, cpu->AF.r8.hi); return 8; } //RES 3, A
-
-       case 0xA0: { cpu->BC.r8.hi = instr_res(4, cpu->BC.r8.hi); return 8; } //RES 4, B
-       case 0xA1: { cpu->BC.r8.lo = instr_res(4, cpu->BC.r8.lo); return 8; } //RES 4, C
-       case 0xA2: { cpu->DE.r8.hi = instr_res(4, cpu->DE.r8.hi); return 8; } //RES 4, D
-       case 0xA3: { cpu->DE.r8.lo = instr_res(4, cpu->DE.r8.lo); return 8; } //RES 4, E
-       case 0xA4: { cpu->HL.r8.hi = instr_res(4, cpu->HL.r8.hi); return 8; } //RES 4, H
-       case 0xA5: { cpu->HL.r8.lo = instr_res(4, cpu->HL.r8.lo); return 8; } //RES 4, L
-       case 0xA6: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(4, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 4, (HL)
-       case 0xA7: { cpu->AF.r8.hi = instr_res(4, cpu->AF.r8.hi); return 8; } //RES 4, A
-       case 0xA8: { cpu->BC.r8.hi = instr_res(5, cpu->BC.r8.hi); return 8; } //RES 5, B
-       case 0xA9: { cpu->BC.r8.lo = instr_res(5, cpu->BC.r8.lo); return 8; } //RES 5, C
-       case 0xAA: { cpu->DE.r8.hi = instr_res(5, cpu->DE.r8.hi); return 8; } //RES 5, D
-       case 0xAB: { cpu->DE.r8.lo = instr_res(5, cpu->DE.r8.lo); return 8; } //RES 5, E
-       case 0xAC: { cpu->HL.r8.hi = instr_res(5, cpu->HL.r8.hi); return 8; } //RES 5, H
-       case 0xAD: { cpu->HL.r8.lo = instr_res(5, cpu->HL.r8.lo); return 8; } //RES 5, L
-       case 0xAE: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(5, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 5, (HL)
-       case 0xAF: { cpu->AF.r8.hi = instr_res(5, cpu->AF.r8.hi); return 8; } //RES 5, A
-
-       case 0xB0: { cpu->BC.r8.hi = instr_res(6, cpu->BC.r8.hi); return 8; } //RES 6, B
-       case 0xB1: { cpu->BC.r8.lo = instr_res(6, cpu->BC.r8.lo); return 8; } //RES 6, C
-       case 0xB2: { cpu->DE.r8.hi = instr_res(6, cpu->DE.r8.hi); return 8; } //RES 6, D
-       case 0xB3: { cpu->DE.r8.lo = instr_res(6, cpu->DE.r8.lo); return 8; } //RES 6, E
-       case 0xB4: { cpu->HL.r8.hi = instr_res(6, cpu->HL.r8.hi); return 8; } //RES 6, H
-       case 0xB5: { cpu->HL.r8.lo = instr_res(6, cpu->HL.r8.lo); return 8; } //RES 6, L
-       case 0xB6: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(6, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 6, (HL)
-       case 0xB7: { cpu->AF.r8.hi = instr_res(6, cpu->AF.r8.hi); return 8; } //RES 6, A
-       case 0xB8: { cpu->BC.r8.hi = instr_res(7, cpu->BC.r8.hi); return 8; } //RES 7, B
-       case 0xB9: { cpu->BC.r8.lo = instr_res(7, cpu->BC.r8.lo); return 8; } //RES 7, C
-       case 0xBA: { cpu->DE.r8.hi = instr_res(7, cpu->DE.r8.hi); return 8; } //RES 7, D
-       case 0xBB: { cpu->DE.r8.lo = instr_res(7, cpu->DE.r8.lo); return 8; } //RES 7, E
-       case 0xBC: { cpu->HL.r8.hi = instr_res(7, cpu->HL.r8.hi); return 8; } //RES 7, H
-       case 0xBD: { cpu->HL.r8.lo = instr_res(7, cpu->HL.r8.lo); return 8; } //RES 7, L
-       case 0xBE: { memory_write8(cpu->bus, cpu->HL.r16, instr_res(7, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //RES 7, (HL)
-       case 0xBF: { cpu->AF.r8.hi = instr_res(7, cpu->AF.r8.hi); return 8; } //RES 7, A
-
-       case 0xC0: { cpu->BC.r8.hi = instr_set(0, cpu->BC.r8.hi); return 8; } //SET 0, B
-       case 0xC1: { cpu->BC.r8.lo = instr_set(0, cpu->BC.r8.lo); return 8; } //SET 0, C
-       case 0xC2: { cpu->DE.r8.hi = instr_set(0, cpu->DE.r8.hi); return 8; } //SET 0, D
-       case 0xC3: { cpu->DE.r8.lo = instr_set(0, cpu->DE.r8.lo); return 8; } //SET 0, E
-       case 0xC4: { cpu->HL.r8.hi = instr_set(0, cpu->HL.r8.hi); return 8; } //SET 0, H
-       case 0xC5: { cpu->HL.r8.lo = instr_set(0, cpu->HL.r8.lo); return 8; } //SET 0, L
-       case 0xC6: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(0, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 0, (HL)
-       case 0xC7: { cpu->AF.r8.hi = instr_set(0, cpu->AF.r8.hi); return 8; } //SET 0, A
-       case 0xC8: { cpu->BC.r8.hi = instr_set(1, cpu->BC.r8.hi); return 8; } //SET 1, B
-       case 0xC9: { cpu->BC.r8.lo = instr_set(1, cpu->BC.r8.lo); return 8; } //SET 1, C
-       case 0xCA: { cpu->DE.r8.hi = instr_set(1, cpu->DE.r8.hi); return 8; } //SET 1, D
-       case 0xCB: { cpu->DE.r8.lo = instr_set(1, cpu->DE.r8.lo); return 8; } //SET 1, E
-       case 0xCC: { cpu->HL.r8.hi = instr_set(1, cpu->HL.r8.hi); return 8; } //SET 1, H
-       case 0xCD: { cpu->HL.r8.lo = instr_set(1, cpu->HL.r8.lo); return 8; } //SET 1, L
-       case 0xCE: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(1, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 1, (HL)
-       case 0xCF: { cpu->AF.r8.hi = instr_set(1, cpu->AF.r8.hi); return 8; } //SET 1, A
- 
-       case 0xD0: { cpu->BC.r8.hi = instr_set(2, cpu->BC.r8.hi); return 8; } //SET 2, B
-       case 0xD1: { cpu->BC.r8.lo = instr_set(2, cpu->BC.r8.lo); return 8; } //SET 2, C
-       case 0xD2: { cpu->DE.r8.hi = instr_set(2, cpu->DE.r8.hi); return 8; } //SET 2, D
-       case 0xD3: { cpu->DE.r8.lo = instr_set(2, cpu->DE.r8.lo); return 8; } //SET 2, E
-       case 0xD4: { cpu->HL.r8.hi = instr_set(2, cpu->HL.r8.hi); return 8; } //SET 2, H
-       case 0xD5: { cpu->HL.r8.lo = instr_set(2, cpu->HL.r8.lo); return 8; } //SET 2, L
-       case 0xD6: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(2, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 2, (HL)
-       case 0xD7: { cpu->AF.r8.hi = instr_set(2, cpu->AF.r8.hi); return 8; } //SET 2, A
-       case 0xD8: { cpu->BC.r8.hi = instr_set(3, cpu->BC.r8.hi); return 8; } //SET 3, B
-       case 0xD9: { cpu->BC.r8.lo = instr_set(3, cpu->BC.r8.lo); return 8; } //SET 3, C
-       case 0xDA: { cpu->DE.r8.hi = instr_set(3, cpu->DE.r8.hi); return 8; } //SET 3, D
-       case 0xDB: { cpu->DE.r8.lo = instr_set(3, cpu->DE.r8.lo); return 8; } //SET 3, E
-       case 0xDC: { cpu->HL.r8.hi = instr_set(3, cpu->HL.r8.hi); return 8; } //SET 3, H
-       case 0xDD: { cpu->HL.r8.lo = instr_set(3, cpu->HL.r8.lo); return 8; } //SET 3, L
-       case 0xDE: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(3, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 3, (HL)
-       case 0xDF: { cpu->AF.r8.hi = instr_set(3, cpu->AF.r8.hi); return 8; } //SET 3, A
- 
-       case 0xE0: { cpu->BC.r8.hi = instr_set(4, cpu->BC.r8.hi); return 8; } //SET 4, B
-       case 0xE1: { cpu->BC.r8.lo = instr_set(4, cpu->BC.r8.lo); return 8; } //SET 4, C
-       case 0xE2: { cpu->DE.r8.hi = instr_set(4, cpu->DE.r8.hi); return 8; } //SET 4, D
-       case 0xE3: { cpu->DE.r8.lo = instr_set(4, cpu->DE.r8.lo); return 8; } //SET 4, E
-       case 0xE4: { cpu->HL.r8.hi = instr_set(4, cpu->HL.r8.hi); return 8; } //SET 4, H
-       case 0xE5: { cpu->HL.r8.lo = instr_set(4, cpu->HL.r8.lo); return 8; } //SET 4, L
-       case 0xE6: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(4, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 4, (HL)
-       case 0xE7: { cpu->AF.r8.hi = instr_set(4, cpu->AF.r8.hi); return 8; } //SET 4, A
-       case 0xE8: { cpu->BC.r8.hi = instr_set(5, cpu->BC.r8.hi); return 8; } //SET 5, B
-       case 0xE9: { cpu->BC.r8.lo = instr_set(5, cpu->BC.r8.lo); return 8; } //SET 5, C
-       case 0xEA: { cpu->DE.r8.hi = instr_set(5, cpu->DE.r8.hi); return 8; } //SET 5, D
-       case 0xEB: { cpu->DE.r8.lo = instr_set(5, cpu->DE.r8.lo); return 8; } //SET 5, E
-       case 0xEC: { cpu->HL.r8.hi = instr_set(5, cpu->HL.r8.hi); return 8; } //SET 5, H
-       case 0xED: { cpu->HL.r8.lo = instr_set(5, cpu->HL.r8.lo); return 8; } //SET 5, L
-       case 0xEE: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(5, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 5, (HL)
-       case 0xEF: { cpu->AF.r8.hi = instr_set(5, cpu->AF.r8.hi); return 8; } //SET 5, A
- 
-       case 0xF0: { cpu->BC.r8.hi = instr_set(6, cpu->BC.r8.hi); return 8; } //SET 6, B
-       case 0xF1: { cpu->BC.r8.lo = instr_set(6, cpu->BC.r8.lo); return 8; } //SET 6, C
-       case 0xF2: { cpu->DE.r8.hi = instr_set(6, cpu->DE.r8.hi); return 8; } //SET 6, D
-       case 0xF3: { cpu->DE.r8.lo = instr_set(6, cpu->DE.r8.lo); return 8; } //SET 6, E
-       case 0xF4: { cpu->HL.r8.hi = instr_set(6, cpu->HL.r8.hi); return 8; } //SET 6, H
-       case 0xF5: { cpu->HL.r8.lo = instr_set(6, cpu->HL.r8.lo); return 8; } //SET 6, L
-       case 0xF6: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(6, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 6, (HL)
-       case 0xF7: { cpu->AF.r8.hi = instr_set(6, cpu->AF.r8.hi); return 8; } //SET 6, A
-       case 0xF8: { cpu->BC.r8.hi = instr_set(7, cpu->BC.r8.hi); return 8; } //SET 7, B
-       case 0xF9: { cpu->BC.r8.lo = instr_set(7, cpu->BC.r8.lo); return 8; } //SET 7, C
-       case 0xFA: { cpu->DE.r8.hi = instr_set(7, cpu->DE.r8.hi); return 8; } //SET 7, D
-       case 0xFB: { cpu->DE.r8.lo = instr_set(7, cpu->DE.r8.lo); return 8; } //SET 7, E
-       case 0xFC: { cpu->HL.r8.hi = instr_set(7, cpu->HL.r8.hi); return 8; } //SET 7, H
-       case 0xFD: { cpu->HL.r8.lo = instr_set(7, cpu->HL.r8.lo); return 8; } //SET 7, L
-       case 0xFE: { memory_write8(cpu->bus, cpu->HL.r16, instr_set(7, memory_read8(cpu->bus, cpu->HL.r16))); return 16; } //SET 7, (HL)
-       case 0xFF: { cpu->AF.r8.hi = instr_set(7, cpu->AF.r8.hi); return 8; } //SET 7, A
-
-        default: fprintf(stderr, "[ERROR] : ILLEGAL INSTRUCTION CB");
-                    abort();
-    }
-}
\ No newline at end of file
+    return opcode_table_CB[opcode].handler(cpu, opcode, 0);
+}
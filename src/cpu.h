@@ -6,6 +6,9 @@
 #include "hard_registers.h"
 #include "memory.h"
 
+struct BlockCache;
+struct Jit;
+
 typedef enum {
     Z_FLAG = 0x80,
     N_FLAG = 0x40,
@@ -13,6 +16,19 @@ typedef enum {
     C_FLAG = 0x10
 } Flag;
 
+//last instruction that produced the flags, F is only computed from it when the flags are read
+typedef enum {
+    FLAGS_SYNCED, //F is up to date
+    FLAGS_ADD, //ADD, ADC
+    FLAGS_SUB, //SUB, SBC, CP
+    FLAGS_AND,
+    FLAGS_LOGIC, //XOR, OR
+    FLAGS_INC, //INC r8, C kept
+    FLAGS_DEC, //DEC r8, C kept
+    FLAGS_SHIFT, //CB rotates and shifts, SWAP
+    FLAGS_BIT //BIT, C kept
+} FlagOp;
+
 typedef enum {
     BIT_7 = 0x80,
     BIT_6 = 0x40,
@@ -39,6 +55,8 @@ typedef enum
 #define SERIAL_ADDR 0x0058
 #define JOYPAD_ADDR 0x0060
 
+#define IDLE_MAX_TICKS 70224 //longest HALT or idle loop skip, the frame event normally comes first
+
 typedef union {
     uint16_t r16;
     struct {
@@ -47,6 +65,28 @@ typedef union {
     } r8;
 } Registre;
 
+//state of a self-looping block at the start of its last iteration, if the next one starts from the same state
+//the loop only polls memory that nothing changes before the next event, and it can be skipped up to there
+typedef struct {
+    const struct Block* block; //block watched, NULL if none
+    uint32_t cycles; //cycles of the iteration, counted while it runs
+
+    Registre AF, BC, DE, HL;
+    uint16_t SP;
+    uint8_t flag_op, flag_a, flag_b, flag_carry, flag_res;
+    bool IME;
+    uint8_t interrupt_requested;
+    uint8_t buttons;
+    uint32_t writes;
+    uint32_t clock_reads;
+    uint32_t ly_reads;
+    uint32_t stat_reads;
+    uint64_t start; //timestamp of the start of the iteration
+
+    uint64_t skips; //stats
+    uint64_t skipped_cycles;
+} IdleLoop;
+
 typedef struct {
     Registre AF;
     Registre BC;
@@ -61,17 +101,45 @@ typedef struct {
     uint8_t ei_delay;
     uint8_t di_delay;
 
+    uint8_t flag_op; //FlagOp pending in AF.r8.lo
+    uint8_t flag_a; //operands of flag_op
+    uint8_t flag_b;
+    uint8_t flag_carry; //carry in (ADC, SBC) or carry out (FLAGS_SHIFT)
+    uint8_t flag_res; //result, Z is set if it is 0
+
+    //the registers above and these pointers share the first cache line, every instruction uses them
     Memory* bus;
+    Scheduler* scheduler; //HALT and idle loops skip to its next event, NULL to step them
+    struct BlockCache* block_cache; //predecoded instructions, NULL to decode every opcode from the bus
+    struct Jit* jit; //compiles the hot blocks of block_cache, NULL to only interpret
+
+    uint8_t* r8[8]; //r8 operand field of the opcodes: B, C, D, E, H, L, (HL) (NULL, read through the bus), A
+    uint16_t* r16[4]; //r16 operand field: BC, DE, HL, SP
+    uint16_t* r16_stack[4]; //r16 operand field of PUSH/POP: BC, DE, HL, AF
 
+    IdleLoop idle;
 } Cpu;
 
+typedef uint32_t (*OpcodeHandler)(Cpu* cpu, uint8_t opcode, uint16_t operand);
+
+typedef struct {
+    OpcodeHandler handler;
+    uint8_t length; //opcode + operand bytes
+    bool jump; //JR, JP, CALL, RET, RST: may load the PC
+} Opcode;
+
+extern const Opcode opcode_table[256];
+extern const Opcode opcode_table_CB[256];
+
 void cpu_init(Cpu* cpu, Memory* memory);
+void cpu_power_on(Cpu* cpu);
 
 uint32_t cpu_execute_instruction(Cpu* cpu, uint8_t opcode);
 uint32_t cpu_execute_instruction_CB(Cpu* cpu, uint8_t opcode);
 
 void cpu_update_ime(Cpu* cpu);
 uint32_t cpu_ticks(Cpu* cpu);
+void cpu_run_until(Cpu* cpu, uint64_t deadline);
 
 
 uint8_t cpu_fetch_byte_pc(Cpu* cpu);
@@ -81,6 +149,17 @@ void cpu_setFlag(Cpu* cpu, Flag flag);
 void cpu_clearFlag(Cpu* cpu, Flag flag);
 void cpu_updateFlag(Cpu* cpu, Flag flag, bool condition);
 uint8_t cpu_getFlag(Cpu* cpu, Flag flag);
+void cpu_syncFlags(Cpu* cpu);
+
+//record the operation instead of computing F, the kept flags (FLAGS_INC, FLAGS_DEC, FLAGS_BIT) must be synced first
+static inline void cpu_deferFlags(Cpu* cpu, FlagOp op, uint8_t a, uint8_t b, uint8_t carry, uint8_t res)
+{
+    cpu->flag_op = op;
+    cpu->flag_a = a;
+    cpu->flag_b = b;
+    cpu->flag_carry = carry;
+    cpu->flag_res = res;
+}
 
 uint32_t handle_interrupts(Cpu* cpu);
 
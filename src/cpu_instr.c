@@ -1,5 +1,6 @@
 #include "cpu.h"
 #include "cpu_instr.h"
+#include <stdlib.h>
 
 uint16_t instr_pop(Cpu* cpu) {
     if (!cpu) { abort(); }
@@ -34,9 +35,8 @@ uint8_t instr_inc8(Cpu* cpu, uint8_t data) {
 
     uint8_t res = data + 1;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, ((data & 0xf) + 1) > 0xf);
+    cpu_syncFlags(cpu); //C is kept
+    cpu_deferFlags(cpu, FLAGS_INC, data, 0, 0, res);
 
     return res;
 }
@@ -46,9 +46,8 @@ uint8_t instr_dec8(Cpu* cpu, uint8_t data) {
 
     uint8_t res = data - 1;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, true);
-    cpu_updateFlag(cpu, H_FLAG, (data & 0xf) == 0);
+    cpu_syncFlags(cpu); //C is kept
+    cpu_deferFlags(cpu, FLAGS_DEC, data, 0, 0, res);
 
     return res;
 }
@@ -135,10 +134,7 @@ void instr_add8(Cpu* cpu, uint8_t data) {
 
     uint8_t res = cpu->AF.r8.hi + data;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, ((cpu->AF.r8.hi & 0xf) + (data & 0xf)) > 0xf);
-    cpu_updateFlag(cpu, C_FLAG, (cpu->AF.r8.hi + data) > 0xff);
+    cpu_deferFlags(cpu, FLAGS_ADD, cpu->AF.r8.hi, data, 0, res);
 
     cpu->AF.r8.hi = res;
 }
@@ -149,10 +145,7 @@ void instr_adc(Cpu* cpu, uint8_t data) {
     uint8_t c = cpu_getFlag(cpu, C_FLAG);
     uint8_t res = cpu->AF.r8.hi + data + c;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, ((cpu->AF.r8.hi & 0xf) + (data & 0xf) + c) > 0xf);
-    cpu_updateFlag(cpu, C_FLAG, (cpu->AF.r8.hi + data + c) > 0xff);
+    cpu_deferFlags(cpu, FLAGS_ADD, cpu->AF.r8.hi, data, c, res);
 
     cpu->AF.r8.hi = res;
 }
@@ -162,10 +155,7 @@ void instr_sub(Cpu* cpu, uint8_t data) {
 
     uint8_t res = cpu->AF.r8.hi - data;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, true);
-    cpu_updateFlag(cpu, H_FLAG, (cpu->AF.r8.hi & 0xf) < (data & 0xf));
-    cpu_updateFlag(cpu, C_FLAG, cpu->AF.r8.hi < data);
+    cpu_deferFlags(cpu, FLAGS_SUB, cpu->AF.r8.hi, data, 0, res);
 
     cpu->AF.r8.hi = res;
 }
@@ -176,10 +166,7 @@ void instr_sbc(Cpu* cpu, uint8_t data) {
     uint8_t c = cpu_getFlag(cpu, C_FLAG);
     uint8_t res = cpu->AF.r8.hi - data - c;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, true);
-    cpu_updateFlag(cpu, H_FLAG, (cpu->AF.r8.hi & 0xf) < ((data & 0xf) + c));
-    cpu_updateFlag(cpu, C_FLAG, cpu->AF.r8.hi < (data + c));
+    cpu_deferFlags(cpu, FLAGS_SUB, cpu->AF.r8.hi, data, c, res);
 
     cpu->AF.r8.hi = res;
 }
@@ -188,10 +175,7 @@ void instr_and(Cpu* cpu, uint8_t data) {
 
     cpu->AF.r8.hi &= data;
 
-    cpu_updateFlag(cpu, Z_FLAG, cpu->AF.r8.hi == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, true); 
-    cpu_updateFlag(cpu, C_FLAG, false);
+    cpu_deferFlags(cpu, FLAGS_AND, 0, 0, 0, cpu->AF.r8.hi);
 }
 
 void instr_xor(Cpu* cpu, uint8_t data) {
@@ -199,10 +183,7 @@ void instr_xor(Cpu* cpu, uint8_t data) {
 
     cpu->AF.r8.hi ^= data;
 
-    cpu_updateFlag(cpu, Z_FLAG, cpu->AF.r8.hi == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, false);
+    cpu_deferFlags(cpu, FLAGS_LOGIC, 0, 0, 0, cpu->AF.r8.hi);
 }
 
 void instr_or(Cpu* cpu, uint8_t data) {
@@ -210,10 +191,7 @@ void instr_or(Cpu* cpu, uint8_t data) {
 
     cpu->AF.r8.hi |= data;
 
-    cpu_updateFlag(cpu, Z_FLAG, cpu->AF.r8.hi == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, false);
+    cpu_deferFlags(cpu, FLAGS_LOGIC, 0, 0, 0, cpu->AF.r8.hi);
 }
 
 void instr_cp(Cpu* cpu, uint8_t data) {
@@ -221,10 +199,7 @@ void instr_cp(Cpu* cpu, uint8_t data) {
 
     uint8_t res = cpu->AF.r8.hi - data;
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, true);
-    cpu_updateFlag(cpu, H_FLAG, (cpu->AF.r8.hi & 0xf) < (data & 0xf));
-    cpu_updateFlag(cpu, C_FLAG, cpu->AF.r8.hi < data);
+    cpu_deferFlags(cpu, FLAGS_SUB, cpu->AF.r8.hi, data, 0, res);
 }
 
 uint8_t instr_rlc(Cpu* cpu, uint8_t data) {
@@ -233,10 +208,7 @@ uint8_t instr_rlc(Cpu* cpu, uint8_t data) {
     uint8_t b7 = data & 0x80;
     uint8_t res = (data << 1) | ((b7) ? 1 : 0);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, b7);
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (b7) ? 1 : 0, res);
 
     return res;
 }
@@ -247,10 +219,7 @@ uint8_t instr_rrc(Cpu* cpu, uint8_t data) {
     uint8_t b0 = data & 0x1;
     uint8_t res = (data >> 1) | ((b0) ? 0x80 : 0);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, b0);
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (b0) ? 1 : 0, res);
 
     return res;
 }
@@ -261,10 +230,7 @@ uint8_t instr_rl(Cpu* cpu, uint8_t data) {
     uint8_t b7 = data & 0x80;
     uint8_t res = (data << 1) | cpu_getFlag(cpu, C_FLAG);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, b7);
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (b7) ? 1 : 0, res);
 
     return res;
 }
@@ -275,10 +241,7 @@ uint8_t instr_rr(Cpu* cpu, uint8_t data) {
     uint8_t b0 = data & 0x1;
     uint8_t res = (data >> 1) | ((cpu_getFlag(cpu, C_FLAG)) ? 0x80: 0);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, b0);
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (b0) ? 1 : 0, res);
 
     return res;
 }
@@ -288,10 +251,7 @@ uint8_t instr_sla(Cpu* cpu, uint8_t data) {
 
     uint8_t res = (data << 1);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, (data & 0x80));
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (data & 0x80) ? 1 : 0, res);
 
     return res;
 }
@@ -301,10 +261,7 @@ uint8_t instr_sra(Cpu* cpu, uint8_t data) {
 
     uint8_t res = (data >> 1) | (data & 0x80);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, (data & 0x1));
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (data & 0x1) ? 1 : 0, res);
 
     return res;
 }
@@ -314,10 +271,7 @@ uint8_t instr_swap(Cpu* cpu, uint8_t data) {
 
     uint8_t res = ((data & 0xf0) >> 4) | ((data & 0x0f) << 4);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, false);
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, 0, res);
 
     return res;
 }
@@ -327,10 +281,7 @@ uint8_t instr_srl(Cpu* cpu, uint8_t data) {
 
     uint8_t res = (data >> 1);
 
-    cpu_updateFlag(cpu, Z_FLAG, res == 0);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, false);
-    cpu_updateFlag(cpu, C_FLAG, (data & 0x1));
+    cpu_deferFlags(cpu, FLAGS_SHIFT, 0, 0, (data & 0x1) ? 1 : 0, res);
 
     return res;
 }
@@ -340,9 +291,8 @@ void instr_bit(Cpu* cpu, uint8_t bit, uint8_t data) {
 
     uint8_t res = (1 << bit) & data;
 
-    cpu_updateFlag(cpu, Z_FLAG, !res);
-    cpu_updateFlag(cpu, N_FLAG, false);
-    cpu_updateFlag(cpu, H_FLAG, true);
+    cpu_syncFlags(cpu); //C is kept
+    cpu_deferFlags(cpu, FLAGS_BIT, 0, 0, 0, res);
 }
 
 uint8_t instr_res(uint8_t bit, uint8_t data) {
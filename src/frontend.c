@@ -0,0 +1,89 @@
+#include "frontend.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+
+static void frontend_null_present(Frontend* frontend, const uint8_t* shades) { return; }
+static void frontend_null_queue_audio(Frontend* frontend, const int16_t* samples, uint32_t count) { return; }
+static bool frontend_null_poll(Frontend* frontend, uint8_t* buttons) { return true; }
+static void frontend_null_close(Frontend* frontend) { return; }
+
+static uint64_t frontend_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+//false if the backend can not be opened, or is not part of this build
+bool frontend_open(Frontend* frontend, FrontendKind kind, uint32_t speed, bool vsync)
+{
+    if (!frontend) { abort(); }
+
+    frontend->kind = kind;
+    frontend->speed = speed;
+    frontend->vsync = vsync;
+    frontend->presented = false;
+    frontend->deadline = 0;
+    frontend->shown = 0;
+    frontend->present = frontend_null_present;
+    frontend->queue_audio = frontend_null_queue_audio;
+    frontend->poll = frontend_null_poll;
+    frontend->close = frontend_null_close;
+    frontend->data = NULL;
+
+    switch (kind) {
+        case FRONTEND_HEADLESS: { return true; }
+        case FRONTEND_SDL: {
+#ifdef NO_SDL
+            fprintf(stderr, "[ERROR]: built without SDL (HEADLESS=1), only the headless frontend is available\n");
+            return false;
+#else
+            return frontend_sdl_open(frontend);
+#endif
+        }
+        default: { abort(); }
+    }
+}
+
+void frontend_close(Frontend* frontend)
+{
+    if (!frontend) { abort(); }
+
+    frontend->close(frontend);
+    frontend->close = frontend_null_close;
+    frontend->data = NULL;
+}
+
+//every frame at speed 1, in turbo only when the display can show it
+void frontend_present(Frontend* frontend, const uint8_t* shades)
+{
+    if (frontend->speed != 1) {
+        uint64_t now = frontend_now();
+        if (now - frontend->shown < FRONTEND_FRAME_NS) { return; }
+        frontend->shown = now;
+    }
+    frontend->present(frontend, shades);
+    frontend->presented = true;
+}
+
+//sleep to the end of the frame. The deadlines are absolute, a late frame is made up by the next ones
+void frontend_pace(Frontend* frontend)
+{
+    bool presented = frontend->presented;
+    frontend->presented = false;
+
+    if (!frontend->speed || (frontend->vsync && frontend->speed == 1 && presented)) {
+        frontend->deadline = 0; //uncapped, or already waited for the display
+        return;
+    }
+
+    uint64_t now = frontend_now();
+    if (!frontend->deadline || now > frontend->deadline + FRONTEND_LATE_FRAMES * FRONTEND_FRAME_NS) { frontend->deadline = now; }
+    frontend->deadline += FRONTEND_FRAME_NS / frontend->speed;
+    if (now >= frontend->deadline) { return; }
+
+    struct timespec deadline = { .tv_sec = frontend->deadline / 1000000000, .tv_nsec = frontend->deadline % 1000000000 };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+}
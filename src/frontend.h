@@ -0,0 +1,50 @@
+#ifndef __FRONTEND_H__
+#define __FRONTEND_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FRONTEND_AUDIO_RATE 48000 //stereo samples per second taken by the audio sink
+#define FRONTEND_FRAME_NS 16742706 //70224 cycles at 4194304 Hz: 59.73 frames per second
+#define FRONTEND_LATE_FRAMES 4 //further behind the deadline than this (pause, slow host), pacing restarts from now
+
+typedef enum {
+    FRONTEND_SDL, //window, audio device and keyboard, not available in a HEADLESS=1 build
+    FRONTEND_HEADLESS //frames and samples dropped, no input: runs unthrottled without any display
+} FrontendKind;
+
+struct Frontend;
+//video sink: a finished frame of SCREEN_HEIGHT lines of SCREEN_WIDTH shades, 0 white to 3 black
+typedef void (*FrontendPresent)(struct Frontend* frontend, const uint8_t* shades);
+//audio sink: count interleaved left/right pairs at FRONTEND_AUDIO_RATE
+typedef void (*FrontendQueueAudio)(struct Frontend* frontend, const int16_t* samples, uint32_t count);
+//input source: buttons as in Joypad.buttons (a bit at 0 is pressed), false once the user asked to quit
+typedef bool (*FrontendPoll)(struct Frontend* frontend, uint8_t* buttons);
+typedef void (*FrontendClose)(struct Frontend* frontend);
+
+//the outside world of a Gameboy, chosen by frontend_open
+typedef struct Frontend {
+    FrontendKind kind;
+    FrontendPresent present;
+    FrontendQueueAudio queue_audio;
+    FrontendPoll poll;
+    FrontendClose close;
+    void* data; //state of the backend
+
+    uint32_t speed; //1 real time, 2 and 4 turbo, 0 uncapped. The backend may change it on user input
+    bool vsync; //present waits for the display refresh, which then paces the frames at speed 1
+    bool presented; //a frame was shown since the last frontend_pace
+    uint64_t deadline; //CLOCK_MONOTONIC time the current frame ends at, 0 to restart the pacing
+    uint64_t shown; //time of the last frame shown, turbo shows at most one per FRONTEND_FRAME_NS
+} Frontend;
+
+bool frontend_open(Frontend* frontend, FrontendKind kind, uint32_t speed, bool vsync);
+void frontend_close(Frontend* frontend);
+void frontend_present(Frontend* frontend, const uint8_t* shades);
+void frontend_pace(Frontend* frontend);
+
+#ifndef NO_SDL
+bool frontend_sdl_open(Frontend* frontend);
+#endif
+
+#endif //__FRONTEND_H__
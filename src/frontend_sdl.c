@@ -0,0 +1,163 @@
+#include "frontend.h"
+#include "ppu.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    SDL_Window* window;
+    SDL_Renderer* render;
+    SDL_Texture* texture; //the framebuffer shades in ARGB
+    SDL_AudioDeviceID audio; //opened with the first samples, 0 until then
+    uint8_t buttons;
+} SdlFrontend;
+
+static void frontend_sdl_redraw(SdlFrontend* sdl)
+{
+    SDL_RenderClear(sdl->render);
+    SDL_RenderCopy(sdl->render, sdl->texture, NULL, NULL);
+    SDL_RenderPresent(sdl->render);
+}
+
+static void frontend_sdl_present(Frontend* frontend, const uint8_t* shades)
+{
+    static const uint32_t colors[4] = { 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555, 0xFF000000 };
+    SdlFrontend* sdl = frontend->data;
+    uint32_t pixels[SCREEN_HEIGHT * SCREEN_WIDTH];
+
+    for (uint32_t i = 0; i < SCREEN_HEIGHT * SCREEN_WIDTH; i++) { pixels[i] = colors[shades[i]]; }
+
+    if (SDL_UpdateTexture(sdl->texture, NULL, pixels, SCREEN_WIDTH * sizeof(uint32_t)) != 0) { return; }
+    frontend_sdl_redraw(sdl);
+}
+
+static void frontend_sdl_queue_audio(Frontend* frontend, const int16_t* samples, uint32_t count)
+{
+    SdlFrontend* sdl = frontend->data;
+
+    if (!sdl->audio) {
+        SDL_AudioSpec spec;
+        SDL_zero(spec);
+        spec.freq = FRONTEND_AUDIO_RATE;
+        spec.format = AUDIO_S16SYS;
+        spec.channels = 2;
+        spec.samples = 1024;
+        sdl->audio = SDL_OpenAudioDevice(NULL, 0, &spec, NULL, 0);
+        if (!sdl->audio) { fprintf(stderr, "[WARNING]: no audio device: %s\n", SDL_GetError()); return; }
+        SDL_PauseAudioDevice(sdl->audio, 0);
+    }
+    SDL_QueueAudio(sdl->audio, samples, count * 2 * sizeof(int16_t));
+}
+
+static uint8_t frontend_sdl_button(SDL_Keycode key)
+{
+    switch (key) {
+        case SDLK_UP: { return 0x04; } //arrow up
+        case SDLK_DOWN: { return 0x08; } //arrow down
+        case SDLK_RIGHT: { return 0x01; } //arrow right
+        case SDLK_LEFT: { return 0x02; } //arrow left
+        case SDLK_z: { return 0x10; } //button A
+        case SDLK_e: { return 0x20; } //button B
+        case SDLK_s: { return 0x40; } //button select
+        case SDLK_d: { return 0x80; } //button start
+        default : { return 0; }
+    }
+}
+
+//a key pressed clears its button bit, released sets it back
+static void frontend_sdl_key(SdlFrontend* sdl, const SDL_Event* event)
+{
+    if (event->type == SDL_KEYDOWN) { sdl->buttons &= ~frontend_sdl_button(event->key.keysym.sym); }
+    if (event->type == SDL_KEYUP) { sdl->buttons |= frontend_sdl_button(event->key.keysym.sym); }
+}
+
+//keys 1 to 4: real time, 2x, 4x, uncapped. 0 for the other keys
+static uint32_t frontend_sdl_speed(SDL_Keycode key)
+{
+    switch (key) {
+        case SDLK_1: { return 1; }
+        case SDLK_2: { return 2; }
+        case SDLK_3: { return 4; }
+        case SDLK_4: { return UINT32_MAX; }
+        default : { return 0; }
+    }
+}
+
+//block in SDL_WaitEvent until P is pressed again, false if the user asked to quit meanwhile.
+//The buttons keep following the keys, a key released during the pause is not left pressed
+static bool frontend_sdl_pause(Frontend* frontend)
+{
+    SdlFrontend* sdl = frontend->data;
+    SDL_Event event;
+
+    while (SDL_WaitEvent(&event)) {
+        if (event.type == SDL_QUIT) { return false; }
+        if (event.type == SDL_WINDOWEVENT) { frontend_sdl_redraw(sdl); }
+        if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_p) { break; }
+        frontend_sdl_key(sdl, &event);
+    }
+    frontend->deadline = 0; //the time paused is not caught up
+    return true;
+}
+
+//drain the SDL event queue into the button state, the speed and the pause
+static bool frontend_sdl_poll(Frontend* frontend, uint8_t* buttons)
+{
+    SdlFrontend* sdl = frontend->data;
+    SDL_Event event;
+
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) { return false; }
+        if (event.type == SDL_KEYDOWN) {
+            uint32_t speed = frontend_sdl_speed(event.key.keysym.sym);
+            if (speed) { frontend->speed = (speed == UINT32_MAX) ? 0 : speed; }
+            if (event.key.keysym.sym == SDLK_p && !frontend_sdl_pause(frontend)) { return false; }
+        }
+        frontend_sdl_key(sdl, &event);
+    }
+    *buttons = sdl->buttons;
+    return true;
+}
+
+static void frontend_sdl_close(Frontend* frontend)
+{
+    SdlFrontend* sdl = frontend->data;
+
+    if (sdl->audio) { SDL_CloseAudioDevice(sdl->audio); }
+    if (sdl->texture) { SDL_DestroyTexture(sdl->texture); }
+    if (sdl->render) { SDL_DestroyRenderer(sdl->render); }
+    if (sdl->window) { SDL_DestroyWindow(sdl->window); }
+    free(sdl);
+    SDL_Quit();
+}
+
+bool frontend_sdl_open(Frontend* frontend)
+{
+    if (!frontend) { abort(); }
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_EVENTS) != 0) {
+        fprintf(stderr, "[ERROR]: initialization of SDL failed: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SdlFrontend* sdl = calloc(1, sizeof(SdlFrontend));
+    if (!sdl) { abort(); }
+    sdl->buttons = 0xFF;
+    frontend->data = sdl;
+    frontend->close = frontend_sdl_close;
+
+    sdl->window = SDL_CreateWindow("DMGemu", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+    uint32_t flags = SDL_RENDERER_ACCELERATED | ((frontend->vsync) ? SDL_RENDERER_PRESENTVSYNC : 0);
+    if (sdl->window) { sdl->render = SDL_CreateRenderer(sdl->window, -1, flags); }
+    if (sdl->render) { sdl->texture = SDL_CreateTexture(sdl->render, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT); }
+    if (!sdl->texture) {
+        fprintf(stderr, "[ERROR]: SDL window creation failed: %s\n", SDL_GetError());
+        frontend_close(frontend);
+        return false;
+    }
+
+    frontend->present = frontend_sdl_present;
+    frontend->queue_audio = frontend_sdl_queue_audio;
+    frontend->poll = frontend_sdl_poll;
+    return true;
+}
@@ -1,29 +1,62 @@
 #include "gameboy.h"
 
-bool gameboy_init(Gameboy* gb, const char* filename) {
-    if (!gb) { return false; }
+static bool gameboy_init(Gameboy* gb, const char* filename, Frontend* frontend, JitMode jit_mode, SaveMode save_mode, BootMode boot_mode) {
+    if (!gb || !frontend) { return false; }
 
-    load_cartridge(&gb->cartridge, filename);
-    timer_init(&gb->timer);
-    serial_init(&gb->serial);
+    gb->frontend = frontend;
+    gb->frames = 0;
+
+    load_cartridge(&gb->cartridge, filename, save_mode, &gb->arena);
+    scheduler_init(&gb->scheduler);
+    timer_init(&gb->timer, &gb->scheduler);
+    serial_init(&gb->serial, &gb->scheduler);
     joypad_init(&gb->joypad);
-    memory_init(&gb->memory, &gb->serial, &gb->timer, &gb->joypad, &gb->cartridge);
+    ppu_init(&gb->ppu, gb->memory.oam_ram, &gb->scheduler);
+    memory_init(&gb->memory, &gb->scheduler, &gb->serial, &gb->timer, &gb->joypad, &gb->cartridge, &gb->ppu);
     cpu_init(&gb->cpu, &gb->memory);
-
-    gb->window = SDL_CreateWindow("DMGemu", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 160, 144, SDL_WINDOW_SHOWN);
-    if (!gb->window) { return false; }
-    gb->render = SDL_CreateRenderer(gb->window, -1, SDL_RENDERER_ACCELERATED);
-    if (!gb->render) { SDL_DestroyWindow(gb->window); return false; }
+    gb->cpu.scheduler = &gb->scheduler;
+    if (boot_mode == BOOT_ROM) { //the modules start from the post boot snapshot, rewind what the boot ROM sets itself
+        cpu_power_on(&gb->cpu);
+        timer_power_on(&gb->timer);
+        ppu_power_on(&gb->ppu);
+        memory_map_boot_rom(&gb->memory);
+    }
+    scheduler_schedule(&gb->scheduler, EVENT_FRAME, FRAME_CYCLES);
+    block_cache_init(&gb->block_cache, &gb->memory, &gb->arena);
+    gb->memory.block_cache = &gb->block_cache;
+    gb->cpu.block_cache = &gb->block_cache;
+    if (!jit_init(&gb->jit, &gb->block_cache, jit_mode)) { return false; }
+    gb->cpu.jit = (gb->jit.mode != JIT_OFF) ? &gb->jit : NULL;
 
     return true;
 }
 
-bool gameboy_draw(Gameboy* gb) {
-    return true;
+//one mmap for the instance and everything it allocates, NULL if the jit can not be created
+Gameboy* gameboy_create(const char* filename, Frontend* frontend, JitMode jit_mode, SaveMode save_mode, BootMode boot_mode) {
+    Arena arena;
+    arena_init(&arena, GAMEBOY_ARENA_SIZE);
+    Gameboy* gb = arena_alloc(&arena, sizeof(Gameboy)); //zeroed
+    gb->arena = arena;
+
+    if (!gameboy_init(gb, filename, frontend, jit_mode, save_mode, boot_mode)) {
+        jit_free(&gb->jit);
+        eject_cartridge(&gb->cartridge);
+        arena = gb->arena;
+        arena_release(&arena);
+        return NULL;
+    }
+    return gb;
+}
+
+//hand the framebuffer of the ppu to the video sink
+void gameboy_draw(Gameboy* gb) {
+    gb->frames++;
+    frontend_present(gb->frontend, &gb->ppu.framebuffer[0][0]);
 }
 
 #ifdef DEBUG
 void log_cpu(Gameboy* gb) {
+    cpu_syncFlags(&gb->cpu);
     printf("A: %2X | F: %2X\n", gb->cpu.AF.r8.hi, gb->cpu.AF.r8.lo);
     printf("B: %2X | C: %2X\n", gb->cpu.BC.r8.hi, gb->cpu.BC.r8.lo);
     printf("D: %2X | E: %2X\n", gb->cpu.DE.r8.hi, gb->cpu.DE.r8.lo);
@@ -32,31 +65,91 @@ void log_cpu(Gameboy* gb) {
 }
 #endif
 
-void gameboy_run(Gameboy* gb) {
-    while (!gb->joypad.exit_gameboy) {
-        #ifdef DEBUG
-        log_cpu(gb);
-        #endif
-        uint32_t ticks = cpu_ticks(&gb->cpu);
+//a frame ended: host time catches up with it, then the input is the freshest. The fallback frame is one frame away
+static void gameboy_end_frame(Gameboy* gb) {
+    frontend_pace(gb->frontend);
+    uint8_t buttons = gb->joypad.buttons;
+    if (!gb->frontend->poll(gb->frontend, &buttons)) { gb->joypad.exit_gameboy = true; }
+    joypad_set_buttons(&gb->joypad, buttons);
+    if (gb->joypad.interrupt) { memory_request_interrupt(&gb->memory, gb->joypad.interrupt); }
+    gb->joypad.interrupt = 0;
+    scheduler_schedule(&gb->scheduler, EVENT_FRAME, gb->scheduler.now + FRAME_CYCLES);
+}
 
-        gb->memory.interrupt_requested |= gb->serial.interrupt;
-        gb->serial.interrupt = 0;
+//handle every event whose timestamp is reached
+void gameboy_handle_events(Gameboy* gb) {
+    EventType event;
 
-        timer_ticks(&gb->timer, ticks);
-        gb->memory.interrupt_requested |= gb->timer.interrupt;
-        gb->timer.interrupt = 0;
+    while (scheduler_pop_due(&gb->scheduler, &event)) {
+        switch (event) {
+            case EVENT_TIMER: {
+                timer_event(&gb->timer);
+                memory_request_interrupt(&gb->memory, gb->timer.interrupt);
+                gb->timer.interrupt = 0;
+                break;
+            }
+            case EVENT_SERIAL: {
+                memory_request_interrupt(&gb->memory, gb->serial.interrupt);
+                gb->serial.interrupt = 0;
+                break;
+            }
+            case EVENT_PPU: {
+                ppu_event(&gb->ppu);
+                memory_request_interrupt(&gb->memory, gb->ppu.interrupt);
+                gb->ppu.interrupt = 0;
+                if (gb->ppu.frame_ready) { gameboy_draw(gb); gameboy_end_frame(gb); } //paced at VBlank, right after the frame is shown
+                gb->ppu.frame_ready = false;
+                break;
+            }
+            case EVENT_DMA: {
+                memory_dma_end(&gb->memory);
+                break;
+            }
+            case EVENT_FRAME: { //no VBlank for a frame: the LCD is off, its blank frames are counted and paced here
+                if (gb->ppu.lcdc & LCDC_ENABLE) { scheduler_schedule(&gb->scheduler, EVENT_FRAME, gb->scheduler.now + FRAME_CYCLES); break; }
+                gb->frames++;
+                gameboy_end_frame(gb);
+                break;
+            }
+            default: { abort(); }
+        }
+    }
+}
 
-        get_event(&gb->joypad);
-        gb->memory.interrupt_requested |= gb->joypad.interrupt;
-        gb->joypad.interrupt = 0;
+//until the input source asks to quit, frame_limit frames are presented or cycle_limit cycles have run (0: no limit)
+void gameboy_run(Gameboy* gb, uint64_t frame_limit, uint64_t cycle_limit) {
+    uint64_t frames = (frame_limit) ? frame_limit : UINT64_MAX;
+    uint64_t cycles = (cycle_limit) ? cycle_limit : EVENT_NEVER;
 
-        //SDL_Delay(60);
+    while (!gb->joypad.exit_gameboy && gb->frames < frames && gb->scheduler.now < cycles) {
+        #ifdef DEBUG
+        while (gb->scheduler.now < gb->scheduler.next && gb->scheduler.now < cycles) {
+            log_cpu(gb);
+            gb->scheduler.now += cpu_ticks(&gb->cpu);
+        }
+        #else
+        cpu_run_until(&gb->cpu, cycles); //uninterrupted up to the next event
+        #endif
 
+        gameboy_handle_events(gb);
     }
 }
 
-void gameboy_quit(Gameboy* gb) {
-    SDL_DestroyRenderer(gb->render);
-    SDL_DestroyWindow(gb->window);
-    eject_cartridge(&gb->cartridge);
+//the devices outside the arena are closed, then the arena goes with everything else. The frontend stays open.
+//false if the save of the cartridge could not be written
+bool gameboy_destroy(Gameboy* gb) {
+    if (!gb) { return true; }
+
+    if (gb->jit.mode == JIT_VERIFY)
+        fprintf(stderr, "[JIT]: %lu blocks compiled, %lu runs verified, %lu diverged\n",
+                (unsigned long)gb->jit.compiled, (unsigned long)gb->jit.verified, (unsigned long)gb->jit.diverged);
+    if (gb->cpu.idle.skips)
+        fprintf(stderr, "[IDLE]: %lu idle loop skips, %lu cycles skipped\n",
+                (unsigned long)gb->cpu.idle.skips, (unsigned long)gb->cpu.idle.skipped_cycles);
+    jit_free(&gb->jit);
+    bool saved = eject_cartridge(&gb->cartridge);
+
+    Arena arena = gb->arena;
+    arena_release(&arena);
+    return saved;
 }
\ No newline at end of file
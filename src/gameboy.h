@@ -7,30 +7,44 @@
 #include "serial.h"
 #include "timer.h"
 #include "cartridge.h"
+#include "block_cache.h"
+#include "scheduler.h"
+#include "jit.h"
+#include "ppu.h"
+#include "arena.h"
+#include "frontend.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
-#include <SDL2/SDL.h>
-
+//a whole instance in one arena (itself, the block cache pools, the cartridge RAM), hot state first:
+//cpu registers and scheduler clock, then the memory map, the devices, and the cold state at the end
 typedef struct {
     Cpu cpu;
+    Scheduler scheduler;
     Memory memory;
-    Joypad joypad;
-    Serial serial;
     Timer timer;
-    Cartridge cartridge;
-
+    Serial serial;
+    Joypad joypad;
+    BlockCache block_cache;
+    Ppu ppu;
 
-    SDL_Window* window;
-    SDL_Renderer* render;
+    Cartridge cartridge;
+    Jit jit;
+    Frontend* frontend; //video, audio and input, owned by the caller
+    uint64_t frames; //presented since power on, and blank frames while the LCD is off
+    Arena arena; //holds this struct
 } Gameboy;
 
-bool gameboy_init(Gameboy* gb, const char* filename);
-bool gameboy_draw(Gameboy* gb);
-void gameboy_run(Gameboy* gb);
-void gameboy_quit(Gameboy* gb);
+//a few pages of the pools and the largest cartridge RAM are never touched, they cost address space only
+#define GAMEBOY_ARENA_SIZE (sizeof(Gameboy) + sizeof(Block) * BLOCK_POOL_SIZE + sizeof(DecodedInstr) * BLOCK_INSTR_POOL_SIZE + 16 * RAM_BANK_SIZE + 4 * ARENA_ALIGN)
+
+Gameboy* gameboy_create(const char* filename, Frontend* frontend, JitMode jit_mode, SaveMode save_mode, BootMode boot_mode);
+bool gameboy_destroy(Gameboy* gb);
+void gameboy_draw(Gameboy* gb);
+void gameboy_handle_events(Gameboy* gb);
+void gameboy_run(Gameboy* gb, uint64_t frame_limit, uint64_t cycle_limit);
 
 #endif
\ No newline at end of file
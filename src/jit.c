@@ -0,0 +1,315 @@
+#include "jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_MAX_BLOCK_CODE 0x800 //worst case size of one compiled block
+
+bool jit_init(Jit* jit, BlockCache* cache, JitMode mode)
+{
+    if (!jit || !cache) { fprintf(stderr, "[ERROR]: jit initialization failed from structure element"); abort(); }
+
+    jit->mode = JIT_OFF;
+    jit->code = NULL;
+    jit->code_used = 0;
+    jit->generation = cache->generation;
+    jit->block_cache = cache;
+    jit->compiled = 0;
+    jit->verified = 0;
+    jit->diverged = 0;
+
+    if (mode == JIT_OFF) { return true; }
+
+#if JIT_SUPPORTED
+    void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) { fprintf(stderr, "[ERROR]: jit code buffer mmap failed\n"); return false; }
+    jit->code = code;
+    jit->mode = mode;
+    return true;
+#else
+    fprintf(stderr, "[WARNING]: jit is only available on x86-64, running the interpreter\n");
+    return true;
+#endif
+}
+
+void jit_free(Jit* jit)
+{
+    if (!jit) { abort(); }
+
+#if JIT_SUPPORTED
+    if (jit->code) { munmap(jit->code, JIT_CODE_SIZE); }
+#endif
+    jit->code = NULL;
+    jit->mode = JIT_OFF;
+}
+
+/********************************   X86-64 CODE GENERATION *******************************************/
+//rbx holds the Cpu*, r12d the cycles of the block. The flag-free register instructions are emitted
+//inline on the Cpu struct, the other ones call their opcode handler with the operand as an immediate
+
+#if JIT_SUPPORTED
+
+static void emit8(Jit* jit, uint8_t data) { jit->code[jit->code_used++] = data; }
+static void emit16(Jit* jit, uint16_t data) { memcpy(&jit->code[jit->code_used], &data, 2); jit->code_used += 2; }
+static void emit32(Jit* jit, uint32_t data) { memcpy(&jit->code[jit->code_used], &data, 4); jit->code_used += 4; }
+static void emit64(Jit* jit, uint64_t data) { memcpy(&jit->code[jit->code_used], &data, 8); jit->code_used += 8; }
+
+static uint32_t cpu_offset(Cpu* cpu, void* field) { return (uint32_t)((uint8_t*)field - (uint8_t*)cpu); }
+
+//add r12d, imm32
+static void emit_add_cycles(Jit* jit, uint32_t* cycles)
+{
+    if (*cycles == 0) { return; }
+    emit8(jit, 0x41); emit8(jit, 0x81); emit8(jit, 0xC4); emit32(jit, *cycles);
+    *cycles = 0;
+}
+
+//mov word [rbx + offset], imm16
+static void emit_store16(Jit* jit, uint32_t offset, uint16_t data)
+{
+    emit8(jit, 0x66); emit8(jit, 0xC7); emit8(jit, 0x83); emit32(jit, offset); emit16(jit, data);
+}
+
+static bool jit_inline_instr(Jit* jit, Cpu* cpu, const DecodedInstr* instr, uint32_t* cycles)
+{
+    OpcodeHandler handler = instr->handler;
+    uint8_t opcode = instr->opcode;
+
+    if (handler == opcode_table[0x00].handler) { *cycles += 4; return true; } //NOP
+
+    if (handler == opcode_table[0x40].handler) { //LD r8, r8
+        emit8(jit, 0x0F); emit8(jit, 0xB6); emit8(jit, 0x83); emit32(jit, cpu_offset(cpu, cpu->r8[opcode & 0x7])); //movzx eax, byte [rbx + src]
+        emit8(jit, 0x88); emit8(jit, 0x83); emit32(jit, cpu_offset(cpu, cpu->r8[(opcode >> 3) & 0x7])); //mov byte [rbx + dst], al
+        *cycles += 4;
+        return true;
+    }
+
+    if (handler == opcode_table[0x06].handler) { //LD r8, n8
+        emit8(jit, 0xC6); emit8(jit, 0x83); emit32(jit, cpu_offset(cpu, cpu->r8[(opcode >> 3) & 0x7])); emit8(jit, instr->operand);
+        *cycles += 8;
+        return true;
+    }
+
+    if (handler == opcode_table[0x01].handler) { //LD r16, n16
+        emit_store16(jit, cpu_offset(cpu, cpu->r16[(opcode >> 4) & 0x3]), instr->operand);
+        *cycles += 12;
+        return true;
+    }
+
+    if (handler == opcode_table[0x03].handler || handler == opcode_table[0x0B].handler) { //INC r16, DEC r16
+        emit8(jit, 0x66); emit8(jit, 0xFF); emit8(jit, (handler == opcode_table[0x03].handler) ? 0x83 : 0x8B);
+        emit32(jit, cpu_offset(cpu, cpu->r16[(opcode >> 4) & 0x3]));
+        *cycles += 8;
+        return true;
+    }
+
+    if (handler == opcode_table[0xC3].handler) { //JP a16
+        emit_store16(jit, cpu_offset(cpu, &cpu->PC), instr->operand);
+        *cycles += 16;
+        return true;
+    }
+
+    return false;
+}
+
+//the instruction can store to the bus: an MBC bank switch, an OAM DMA start or a store into cached code
+//clears block_cache->current, and the rest of the block must not run then
+static bool jit_instr_writes(const DecodedInstr* instr)
+{
+    uint8_t opcode = instr->opcode;
+
+    if (instr->handler != opcode_table[opcode].handler) { return (opcode & 0x07) == 0x06 && (opcode & 0xC0) != 0x40; } //CB on (HL), BIT only reads
+    if (opcode >= 0x70 && opcode <= 0x77) { return opcode != 0x76; } //LD (HL), r8
+    switch (opcode) {
+        case 0x02: case 0x12: case 0x22: case 0x32: //LD (BC)/(DE)/(HL+)/(HL-), A
+        case 0x08: case 0x34: case 0x35: case 0x36: //LD (a16), SP; INC/DEC (HL); LD (HL), n8
+        case 0xE0: case 0xE2: case 0xEA: //LDH (a8), A; LD (C), A; LD (a16), A
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5: //PUSH
+        case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: //CALL
+        case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF: { return true; } //RST
+        default: { return false; }
+    }
+}
+
+static bool jit_compile(Jit* jit, Cpu* cpu, Block* block)
+{
+    for (uint8_t i = 0; i < block->count; i++) { //the EI/DI delay, HALT and STOP are counted per instruction by cpu_ticks
+        OpcodeHandler handler = block->instr[i].handler;
+        if (handler == opcode_table[0x76].handler || handler == opcode_table[0x10].handler ||
+            handler == opcode_table[0xF3].handler || handler == opcode_table[0xFB].handler)
+            return false;
+    }
+
+    if (jit->code_used + JIT_MAX_BLOCK_CODE > JIT_CODE_SIZE) { //full: drop every compiled block
+        for (uint32_t i = 0; i < jit->block_cache->nbr_blocks; i++) { jit->block_cache->blocks[i].native = NULL; }
+        jit->code_used = 0;
+    }
+
+    if (mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) { return false; }
+
+    uint8_t* start = &jit->code[jit->code_used];
+    uint32_t exits[BLOCK_MAX_INSTR];
+    uint8_t nbr_exits = 0;
+    uint32_t cycles = 0;
+    uint16_t pc = block->pc;
+    bool pc_stored = false; //the last instruction left the PC right
+
+    emit8(jit, 0x53); //push rbx
+    emit8(jit, 0x41); emit8(jit, 0x54); //push r12
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xEC); emit8(jit, 0x08); //sub rsp, 8
+    emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xFB); //mov rbx, rdi
+    emit8(jit, 0x45); emit8(jit, 0x31); emit8(jit, 0xE4); //xor r12d, r12d
+
+    for (uint8_t i = 0; i < block->count; i++) {
+        const DecodedInstr* instr = &block->instr[i];
+        pc += instr->length;
+
+        if (jit_inline_instr(jit, cpu, instr, &cycles)) { pc_stored = (instr->handler == opcode_table[0xC3].handler); continue; }
+        pc_stored = true;
+
+        emit_add_cycles(jit, &cycles);
+        emit_store16(jit, cpu_offset(cpu, &cpu->PC), pc); //the handler sees the PC after its operand
+        emit8(jit, 0x48); emit8(jit, 0x89); emit8(jit, 0xDF); //mov rdi, rbx
+        emit8(jit, 0xBE); emit32(jit, instr->opcode); //mov esi, opcode
+        emit8(jit, 0xBA); emit32(jit, instr->operand); //mov edx, operand
+        emit8(jit, 0x48); emit8(jit, 0xB8); emit64(jit, (uint64_t)(uintptr_t)instr->handler); //mov rax, handler
+        emit8(jit, 0xFF); emit8(jit, 0xD0); //call rax
+        emit8(jit, 0x41); emit8(jit, 0x01); emit8(jit, 0xC4); //add r12d, eax
+
+        if (jit_instr_writes(instr) && i + 1 < block->count) { //same early exit as jit_interpret_block
+            emit8(jit, 0x48); emit8(jit, 0xA1); emit64(jit, (uint64_t)(uintptr_t)&jit->block_cache->current); //mov rax, [current]
+            emit8(jit, 0x48); emit8(jit, 0x85); emit8(jit, 0xC0); //test rax, rax
+            emit8(jit, 0x0F); emit8(jit, 0x84); exits[nbr_exits++] = jit->code_used; emit32(jit, 0); //jz exit
+        }
+    }
+
+    emit_add_cycles(jit, &cycles);
+    if (!pc_stored) { emit_store16(jit, cpu_offset(cpu, &cpu->PC), block->end_pc); }
+
+    for (uint8_t i = 0; i < nbr_exits; i++) {
+        int32_t rel = (int32_t)(jit->code_used - (exits[i] + 4));
+        memcpy(&jit->code[exits[i]], &rel, 4);
+    }
+
+    emit8(jit, 0x44); emit8(jit, 0x89); emit8(jit, 0xE0); //mov eax, r12d
+    emit8(jit, 0x48); emit8(jit, 0x83); emit8(jit, 0xC4); emit8(jit, 0x08); //add rsp, 8
+    emit8(jit, 0x41); emit8(jit, 0x5C); //pop r12
+    emit8(jit, 0x5B); //pop rbx
+    emit8(jit, 0xC3); //ret
+
+    if (mprotect(jit->code, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) { fprintf(stderr, "[ERROR]: jit mprotect failed"); abort(); }
+
+    block->native = start;
+    jit->compiled++;
+    return true;
+}
+
+#else
+
+static bool jit_compile(Jit* jit, Cpu* cpu, Block* block) { return false; }
+
+#endif
+
+/********************************   VERIFY MODE *******************************************/
+
+static void jit_state_save(JitState* state, Cpu* cpu)
+{
+    state->cpu = *cpu;
+    state->interrupt_requested = cpu->bus->interrupt_requested;
+    state->interrupt_enable = cpu->bus->interrupt_enable;
+    memcpy(state->work_ram, cpu->bus->work_ram, WORKRAM_SIZE);
+    memcpy(state->high_ram, cpu->bus->high_ram, HIGHRAM_SIZE);
+    memcpy(state->oam_ram, cpu->bus->oam_ram, OAMRAM_SIZE);
+}
+
+static void jit_state_restore(JitState* state, Cpu* cpu)
+{
+    *cpu = state->cpu;
+    cpu->bus->interrupt_requested = state->interrupt_requested;
+    cpu->bus->interrupt_enable = state->interrupt_enable;
+    memory_update_interrupt_pending(cpu->bus);
+    memcpy(cpu->bus->work_ram, state->work_ram, WORKRAM_SIZE);
+    memcpy(cpu->bus->high_ram, state->high_ram, HIGHRAM_SIZE);
+    memcpy(cpu->bus->oam_ram, state->oam_ram, OAMRAM_SIZE);
+    ppu_index_objects(cpu->bus->ppu); //the sprite index follows the restored Y bytes
+}
+
+static bool jit_state_equal(JitState* state, Cpu* cpu)
+{
+    cpu_syncFlags(&state->cpu); //both sides may have deferred different operations for the same F
+    cpu_syncFlags(cpu);
+    return state->cpu.AF.r16 == cpu->AF.r16 && state->cpu.BC.r16 == cpu->BC.r16 &&
+           state->cpu.DE.r16 == cpu->DE.r16 && state->cpu.HL.r16 == cpu->HL.r16 &&
+           state->cpu.PC == cpu->PC && state->cpu.SP == cpu->SP && state->cpu.IME == cpu->IME &&
+           state->interrupt_requested == cpu->bus->interrupt_requested &&
+           state->interrupt_enable == cpu->bus->interrupt_enable &&
+           memcmp(state->work_ram, cpu->bus->work_ram, WORKRAM_SIZE) == 0 &&
+           memcmp(state->high_ram, cpu->bus->high_ram, HIGHRAM_SIZE) == 0 &&
+           memcmp(state->oam_ram, cpu->bus->oam_ram, OAMRAM_SIZE) == 0;
+}
+
+//the whole block through the opcode handlers, with the same early exit as the compiled code
+static uint32_t jit_interpret_block(Jit* jit, Cpu* cpu, Block* block)
+{
+    uint32_t cycles = 0;
+    for (uint8_t i = 0; i < block->count && jit->block_cache->current; i++) {
+        const DecodedInstr* instr = &block->instr[i];
+        cpu->PC += instr->length;
+        cycles += instr->handler(cpu, instr->opcode, instr->operand);
+    }
+    return cycles;
+}
+
+static uint32_t jit_verify_block(Jit* jit, Cpu* cpu, Block* block)
+{
+    jit_state_save(&jit->before, cpu);
+    uint32_t io_writes = cpu->bus->io_writes;
+    uint32_t cycles = jit_interpret_block(jit, cpu, block);
+    if (cpu->bus->io_writes != io_writes || !jit->block_cache->current) { return cycles; } //can't be replayed, keep the interpreter result
+
+    jit_state_save(&jit->reference, cpu);
+    jit_state_restore(&jit->before, cpu);
+    uint32_t jit_cycles = ((JitCode)block->native)(cpu);
+    jit->verified++;
+
+    if (jit_cycles != cycles || !jit_state_equal(&jit->reference, cpu)) {
+        jit->diverged++;
+        fprintf(stderr, "[JIT]: block %04X (bank %d) diverged from the interpreter: PC %04X/%04X, %u/%u cycles\n",
+                block->pc, block->rom_bank, cpu->PC, jit->reference.cpu.PC, jit_cycles, cycles);
+        jit_state_restore(&jit->reference, cpu);
+        block->native = NULL;
+        block->jit_rejected = true;
+    }
+    return cycles;
+}
+
+/************************************************************************************************************************ */
+
+//run the whole block compiled if it is hot (PC is block->pc), 0 if it has to be interpreted
+uint32_t jit_run_block(Jit* jit, Cpu* cpu, Block* block)
+{
+    if (!jit || !cpu || !block) { abort(); }
+
+    if (jit->mode == JIT_OFF || block->pc >= 0x8000 || block->jit_rejected) { return 0; } //only ROM is compiled
+
+    if (jit->generation != jit->block_cache->generation) { //the block cache was flushed with the blocks pointing to the code
+        jit->generation = jit->block_cache->generation;
+        jit->code_used = 0;
+    }
+
+    if (!block->native) {
+        if (++block->hits < JIT_THRESHOLD) { return 0; }
+        if (!jit_compile(jit, cpu, block)) { block->jit_rejected = true; return 0; }
+    }
+
+    if (jit->mode == JIT_VERIFY) { return jit_verify_block(jit, cpu, block); }
+
+    return ((JitCode)block->native)(cpu);
+}
@@ -0,0 +1,52 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "cpu.h"
+#include "memory.h"
+#include "block_cache.h"
+
+#define JIT_THRESHOLD 64 //block entries before it is compiled
+#define JIT_CODE_SIZE 0x100000
+
+typedef enum {
+    JIT_OFF,
+    JIT_ON,
+    JIT_VERIFY //run the interpreter and the compiled block on the same state and compare them
+} JitMode;
+
+typedef uint32_t (*JitCode)(Cpu* cpu);
+
+//guest state compared in verify mode, I/O is not part of it (blocks writing outside RAM are not replayed)
+typedef struct {
+    Cpu cpu;
+    uint8_t interrupt_requested;
+    uint8_t interrupt_enable;
+    uint8_t work_ram[WORKRAM_SIZE];
+    uint8_t high_ram[HIGHRAM_SIZE];
+    uint8_t oam_ram[OAMRAM_SIZE];
+} JitState;
+
+typedef struct Jit {
+    JitMode mode;
+    uint8_t* code; //JIT_CODE_SIZE bytes mapped executable
+    size_t code_used;
+    uint32_t generation; //block cache generation the code was compiled for
+
+    uint64_t compiled;
+    uint64_t verified;
+    uint64_t diverged;
+
+    JitState before; //state before the block in verify mode
+    JitState reference; //state after the interpreted block in verify mode
+
+    BlockCache* block_cache;
+} Jit;
+
+bool jit_init(Jit* jit, BlockCache* cache, JitMode mode);
+void jit_free(Jit* jit);
+uint32_t jit_run_block(Jit* jit, Cpu* cpu, Block* block);
+
+#endif //__JIT_H__
@@ -1,27 +1,72 @@
-#include <SDL2/SDL.h>
 #include "gameboy.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+static double main_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
 int main(int ac, char** av)
 {
+    const char* filename = NULL;
+    JitMode jit_mode = JIT_OFF;
+    SaveMode save_mode = SAVE_MMAP;
+    BootMode boot_mode = BOOT_ROM;
+#ifdef NO_SDL
+    FrontendKind frontend_kind = FRONTEND_HEADLESS;
+#else
+    FrontendKind frontend_kind = FRONTEND_SDL;
+#endif
+    int speed = -1; //real time with a window, uncapped headless
+    bool vsync = false;
+    uint64_t frame_limit = 0;
+    uint64_t cycle_limit = 0;
+
+    for (int i = 1; i < ac; i++) {
+        if (strcmp(av[i], "--jit") == 0) { jit_mode = JIT_ON; }
+        else if (strcmp(av[i], "--jit-verify") == 0) { jit_mode = JIT_VERIFY; }
+        else if (strcmp(av[i], "--save-commit") == 0) { save_mode = SAVE_COMMIT; }
+        else if (strcmp(av[i], "--no-save") == 0) { save_mode = SAVE_NONE; }
+        else if (strcmp(av[i], "--instant-boot") == 0) { boot_mode = BOOT_INSTANT; }
+        else if (strcmp(av[i], "--headless") == 0) { frontend_kind = FRONTEND_HEADLESS; }
+        else if (strcmp(av[i], "--speed") == 0 && i + 1 < ac) { speed = atoi(av[++i]); }
+        else if (strcmp(av[i], "--vsync") == 0) { vsync = true; }
+        else if (strcmp(av[i], "--frames") == 0 && i + 1 < ac) { frame_limit = strtoull(av[++i], NULL, 10); }
+        else if (strcmp(av[i], "--cycles") == 0 && i + 1 < ac) { cycle_limit = strtoull(av[++i], NULL, 10); }
+        else { filename = av[i]; }
+    }
 
-    if (ac == 1)
+    if (!filename) {
+        fprintf(stderr, "usage: %s [--jit | --jit-verify] [--save-commit | --no-save] [--instant-boot] [--headless] [--speed 1 | 2 | 4 | 0] [--vsync] [--frames n] [--cycles n] rom.gb\n", av[0]);
         return 1;
+    }
+
+    if (speed < 0) { speed = (frontend_kind == FRONTEND_HEADLESS) ? 0 : 1; }
 
-    if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
-        fprintf(stderr, "[Error] : initialization of SDL failed");
-        abort();
+    Frontend frontend;
+    if (!frontend_open(&frontend, frontend_kind, speed, vsync)) {
+        return 1;
     }
 
-    Gameboy gb;
-    if (!gameboy_init(&gb, av[1])) {
+    Gameboy* gb = gameboy_create(filename, &frontend, jit_mode, save_mode, boot_mode);
+    if (!gb) {
+        frontend_close(&frontend);
         return 1;
     }
-    gameboy_run(&gb);
-    gameboy_quit(&gb);
+    double start = main_seconds();
+    gameboy_run(gb, frame_limit, cycle_limit);
+    double elapsed = main_seconds() - start;
+    if (frontend_kind == FRONTEND_HEADLESS)
+        fprintf(stderr, "[HEADLESS]: %lu frames, %lu cycles in %.3f s, %.1f times real time\n",
+                (unsigned long)gb->frames, (unsigned long)gb->scheduler.now, elapsed, gb->scheduler.now / (elapsed * 4194304.0));
+    bool saved = gameboy_destroy(gb);
 
-    SDL_Quit();
-    return 0;
-}
\ No newline at end of file
+    frontend_close(&frontend);
+    return (saved) ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #include "memory.h"
 #include "hard_registers.h"
+#include "block_cache.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -24,20 +25,185 @@ static const uint8_t bootRom[0x100] = {
     0xF5, 0x06, 0x19, 0x78, 0x86, 0x23, 0x05, 0x20, 0xFB, 0x86, 0x00, 0x00, 0x3E, 0x01, 0xE0, 0x50
 };
 
-void memory_init(Memory* memory, Serial* serial, Timer* timer, Joypad* joypad, Cartridge* cartridge)
+//the page tables a mapping change goes to: the ones set aside while OAM DMA blocks the bus
+static const uint8_t** memory_read_pages(Memory* memory) { return (memory->dma_active) ? memory->dma_read_page : memory->read_page; }
+static uint8_t** memory_write_pages(Memory* memory) { return (memory->dma_active) ? memory->dma_write_page : memory->write_page; }
+
+//point the ROM and external RAM pages at the current banks of the cartridge, the pages left NULL go through cartridge_read
+static void memory_map_cartridge(Memory* memory)
+{
+    Cartridge* cartridge = memory->cartridge;
+    const uint8_t** read_page = memory_read_pages(memory);
+
+    for (uint16_t page = 0x00; page < 0x40; page++) { read_page[page] = cartridge->rom0 + (page << 8); }
+    for (uint16_t page = 0x40; page < 0x80; page++) { read_page[page] = cartridge->romx + ((page - 0x40) << 8); }
+    if (memory->bootrom_mapped) { read_page[0x00] = bootRom; } //boot rom overlay
+
+    for (uint16_t page = 0xA0; page < 0xC0; page++) {
+        read_page[page] = (cartridge->ram_mapped) ? cartridge->ram_mapped + ((page - 0xA0) << 8) : NULL;
+    }
+}
+
+static void memory_map_init(Memory* memory)
+{
+    for (uint16_t page = 0x00; page < 0x100; page++) {
+        memory->read_page[page] = NULL;
+        memory->write_page[page] = NULL;
+    }
+
+    //VRAM is read directly, its writes go through ppu_write_vram to update the decoded tiles
+    for (uint16_t page = 0x80; page < 0xA0; page++) { memory->read_page[page] = &memory->ppu->vram[(page - 0x80) << 8]; }
+
+    //work ram and its echo up to FDFF
+    for (uint16_t page = 0xC0; page < 0xFE; page++) {
+        memory->read_page[page] = &memory->work_ram[(page << 8) & 0x1FFF];
+        memory->write_page[page] = &memory->work_ram[(page << 8) & 0x1FFF];
+    }
+
+    memory_map_cartridge(memory);
+}
+
+static uint8_t io_read_joypad(void* device, uint16_t address) { return joypad_read(((Memory*)device)->joypad, address); }
+//a select write can pull a line low with a button held, the interrupt is not left to the next frame
+static void io_write_joypad(void* device, uint16_t address, uint8_t data)
+{
+    Memory* memory = device;
+    joypad_write(memory->joypad, address, data);
+    if (memory->joypad->interrupt) { memory_request_interrupt(memory, memory->joypad->interrupt); }
+    memory->joypad->interrupt = 0;
+}
+static uint8_t io_read_serial(void* device, uint16_t address) { return serial_read(device, address); }
+static void io_write_serial(void* device, uint16_t address, uint8_t data) { serial_write(device, address, data); }
+
+static uint8_t io_read_timer(void* device, uint16_t address)
+{
+    Memory* memory = device;
+    memory->clock_reads++;
+    return timer_read(memory->timer, address);
+}
+static void io_write_timer(void* device, uint16_t address, uint8_t data) { timer_write(((Memory*)device)->timer, address, data); }
+
+static uint8_t io_read_ppu(void* device, uint16_t address)
+{
+    Memory* memory = device;
+    if (address == LY) { memory->ly_reads++; }
+    else if (address == STAT) { memory->stat_reads++; }
+    return ppu_read(memory->ppu, address);
+}
+static void io_write_ppu(void* device, uint16_t address, uint8_t data) { ppu_write(((Memory*)device)->ppu, address, data); }
+
+static uint8_t io_read_if(void* device, uint16_t address) { return ((Memory*)device)->interrupt_requested; }
+static void io_write_if(void* device, uint16_t address, uint8_t data)
+{
+    Memory* memory = device;
+    memory->interrupt_requested = (data | 0xE0);
+    memory_update_interrupt_pending(memory);
+}
+
+//the overlay can not come back once removed, so the ROM blocks cached below 0x100 stay valid
+static void io_write_bootrom(void* device, uint16_t address, uint8_t data)
+{
+    Memory* memory = device;
+    if (!data || !memory->bootrom_mapped) { return; }
+    memory->bootrom_mapped = false;
+    memory_read_pages(memory)[0x00] = memory->cartridge->rom0;
+}
+
+//OAM DMA: the 160 bytes are copied at once, then the bus stays blocked for DMA_CYCLES until EVENT_DMA
+static uint8_t io_read_dma(void* device, uint16_t address) { return ((Memory*)device)->dma; }
+static void io_write_dma(void* device, uint16_t address, uint8_t data)
+{
+    Memory* memory = device;
+    memory->dma = data;
+
+    uint8_t page = (data >= 0xE0) ? data - 0x20 : data; //E000-FFFF sources read the work ram
+    const uint8_t* source = memory_read_pages(memory)[page];
+    uint8_t bytes[OAMRAM_SIZE];
+    if (!source) { //external RAM behind the cartridge handlers
+        for (uint16_t i = 0; i < OAMRAM_SIZE; i++) { bytes[i] = cartridge_read(memory->cartridge, (page << 8) | i); }
+        source = bytes;
+    }
+    ppu_dma_oam(memory->ppu, source);
+
+    if (!memory->dma_active) { //every access goes through memory_read_unmapped/memory_write_unmapped meanwhile
+        memcpy(memory->dma_read_page, memory->read_page, sizeof(memory->read_page));
+        memcpy(memory->dma_write_page, memory->write_page, sizeof(memory->write_page));
+        memset(memory->read_page, 0, sizeof(memory->read_page));
+        memset(memory->write_page, 0, sizeof(memory->write_page));
+        memory->dma_active = true;
+        if (memory->block_cache) { block_cache_dma_started(memory->block_cache); }
+    }
+    scheduler_schedule(memory->scheduler, EVENT_DMA, memory->scheduler->now + DMA_CYCLES);
+}
+
+//plug the handlers of an I/O register, NULL handlers read or write the backing byte memory->io. read_mask holds the unused bits, they read as 1
+void memory_io_register(Memory* memory, uint16_t address, IoReadHandler read, IoWriteHandler write, void* device, uint8_t read_mask)
+{
+    if (!memory || address < 0xFF00 || address >= 0xFF00 + IO_SIZE) { fprintf(stderr, "[ERROR]: invalid I/O register"); abort(); }
+
+    IoRegister* reg = &memory->io_registers[address & 0x7F];
+    reg->read = read;
+    reg->write = write;
+    reg->device = device;
+    reg->read_mask = read_mask;
+}
+
+//registers without a peripheral read 0xFF and keep what is written in memory->io
+static void memory_io_init(Memory* memory)
+{
+    memset(memory->io, 0, sizeof(uint8_t) * IO_SIZE);
+    for (uint16_t address = 0xFF00; address < 0xFF00 + IO_SIZE; address++) { memory_io_register(memory, address, NULL, NULL, NULL, 0xFF); }
+
+    memory_io_register(memory, P1, io_read_joypad, io_write_joypad, memory, 0xC0);
+    memory_io_register(memory, SB, io_read_serial, io_write_serial, memory->serial, 0x00);
+    memory_io_register(memory, SC, io_read_serial, io_write_serial, memory->serial, 0x7E);
+    memory_io_register(memory, DIV, io_read_timer, io_write_timer, memory, 0x00);
+    memory_io_register(memory, TIMA, io_read_timer, io_write_timer, memory, 0x00);
+    memory_io_register(memory, TMA, io_read_timer, io_write_timer, memory, 0x00);
+    memory_io_register(memory, TAC, io_read_timer, io_write_timer, memory, 0xF8);
+    memory_io_register(memory, IF, io_read_if, io_write_if, memory, 0xE0);
+    memory_io_register(memory, LCDC, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, STAT, io_read_ppu, io_write_ppu, memory, 0x80);
+    memory_io_register(memory, SCY, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, SCX, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, LY, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, LYC, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, BGP, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, OBP0, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, OBP1, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, WY, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, WX, io_read_ppu, io_write_ppu, memory, 0x00);
+    memory_io_register(memory, DMA, io_read_dma, io_write_dma, memory, 0x00);
+    memory_io_register(memory, 0xFF50, NULL, io_write_bootrom, memory, 0xFF);
+}
+
+void memory_init(Memory* memory, Scheduler* scheduler, Serial* serial, Timer* timer, Joypad* joypad, Cartridge* cartridge, Ppu* ppu)
 {
-    if (!memory || !serial || !timer || !joypad || !cartridge) {
+    if (!memory || !scheduler || !serial || !timer || !joypad || !cartridge || !ppu) {
         fprintf(stderr, "[ERROR]: memory initialization failed from structure element");
         abort();
     }
 
+    memory->scheduler = scheduler;
     memory->joypad = joypad;
     memory->timer = timer;
     memory->serial = serial;
     memory->cartridge = cartridge;
-    memory->disable_bootrom = 0x00;
+    memory->ppu = ppu;
+    memory->block_cache = NULL;
+    memory->io_writes = 0;
+    memory->writes = 0;
+    memory->clock_reads = 0;
+    memory->ly_reads = 0;
+    memory->stat_reads = 0;
+    memory->bootrom_mapped = false; //state after the boot ROM, memory_map_boot_rom puts it back for a real boot
+    memory->dma_active = false;
+    memory->dma = 0xFF;
     memory->interrupt_enable = 0xFF;
     memory->interrupt_requested = 0xE1;
+    memory_update_interrupt_pending(memory);
+    memory_map_init(memory);
+    memory_io_init(memory);
 
     memset(memory->high_ram, 0, sizeof(uint8_t) * HIGHRAM_SIZE);
     memset(memory->oam_ram, 0, sizeof(uint8_t) * OAMRAM_SIZE);
@@ -68,195 +234,102 @@ void memory_init(Memory* memory, Serial* serial, Timer* timer, Joypad* joypad, C
     memory_write8(memory, NR52, 0xF1);
     memory_write8(memory, LCDC, 0x91);
     memory_write8(memory, STAT, 0x85);
-    memory_write8(memory, DMA, 0xFF);
     memory_write8(memory, BGP, 0xFC);
     memory_write8(memory, IE, 0xFF);
 }
 
-uint8_t memory_read8(Memory* memory, uint16_t address)
+//accesses outside the directly mapped pages: VRAM, OAM, I/O, HRAM, IE, cartridge areas without a page and protected work ram
+uint8_t memory_read_unmapped(Memory* memory, uint16_t address)
 {
     if (!memory) {
         fprintf(stderr, "[ERROR]: memory structure is NULL");
         abort();
     }
 
-    if (address >= 0x0 && address <= 0xFF && !memory->disable_bootrom)
-        return bootRom[address];
-
-    switch (address & 0xF000) {
-        //ROM from cartridge
-        case 0x0000:
-        case 0x1000:
-        case 0x2000:
-        case 0x3000:
-        case 0x4000:
-        case 0x5000:
-        case 0x6000:
-        case 0x7000: { return cartridge_read(memory->cartridge, address); }
-
-        //VRAM ppu
-        case 0x8000:
-        case 0x9000: { return 0; } //TODO ppu_read(ppu, address)
-
-        //EXTERNAL RAM from cartridge
-        case 0xA000:
-        case 0xB000: { return cartridge_read(memory->cartridge, address); }
-
-        //WORK RAM
-        case 0xC000:
-        case 0xD000: { return memory->work_ram[address & 0x1FFF]; }
-        
-        //echo work ram
-        case 0xE000: { return memory->work_ram[address & 0x1FFF]; }
-
-        case 0xF000: { 
-            switch (address & 0x0F00) {
-                //echo work ram
-                case 0x000:
-                case 0x100:
-                case 0x200:
-                case 0x300:
-                case 0x400:
-                case 0x500:
-                case 0x600:
-                case 0x700:
-                case 0x800:
-                case 0x900:
-                case 0xA00:
-                case 0xB00:
-                case 0xC00:
-                case 0xD00: { return memory->work_ram[address & 0x1FFF]; }
-
-                case 0xE00:  { 
-                        switch (address & 0x00F0) {
-                        //OAM
-                        case 0x00:
-                        case 0x10:
-                        case 0x20:
-                        case 0x30:
-                        case 0x40:
-                        case 0x50:
-                        case 0x60:
-                        case 0x70:
-                        case 0x80:
-                        case 0x90: { return memory->oam_ram[address - 0xFE00]; }
-
-                        //FEA0 - FEFF range prohibited
-                        default: { return 0xFF; }
-                    }
-                }
-
-                case 0xF00: {
-                    if ((address & 0xFF) >= 0x00 && (address & 0xFF) <= 0x7F) { //I/O registers
-                        if (address == 0xFF00) { return joypad_read(memory->joypad, address); }
-                        else if ((address >= 0xFF01) && (address <= 0xFF02)) { return serial_read(memory->serial, address); }
-                        else if ((address >= 0xFF04) && (address <= 0xFF07)) { return timer_read(memory->timer, address); }
-                        else if (address == 0xFF0F) { return memory->interrupt_requested; }
-                        else if ((address >= 0xFF40) && (address <= 0xFF4B)) { if (address == LY) { return 0x90; } } //TODO return ppu_read(ppu, address)}
-                        else if (address == 0xFF50) { return memory->disable_bootrom; }
-                        else { return 0xFF; }
-                    } 
-                    else if ((address & 0xFF) >= 0x80 && (address & 0xFF) <= 0xFE)  { return memory->high_ram[address - 0xFF80]; } //high ram
-                    else { return memory->interrupt_enable; } //IE register
-                }
-
-                default: { return 0xFF; }
-            }
-        }
-        default: { return 0xFF; }
+    if ((address & 0xFF80) == 0xFF00) { //I/O registers first, they are most of the accesses here
+        IoRegister* reg = &memory->io_registers[address & 0x7F];
+        uint8_t data = (reg->read) ? reg->read(reg->device, address) : memory->io[address & 0x7F];
+        return data | reg->read_mask;
     }
+    if (memory->dma_active && address < 0xFF00) { return 0xFF; } //OAM DMA holds the bus
+
+    if (address <= 0x7FFF) { return cartridge_read(memory->cartridge, address); } //ROM
+    if (address <= 0x9FFF) { return memory->ppu->vram[address & (VRAM_SIZE - 1)]; } //VRAM, normally read through its pages
+    if (address <= 0xBFFF) { return cartridge_read(memory->cartridge, address); } //EXTERNAL RAM
+    if (address <= 0xFDFF) { return memory->work_ram[address & 0x1FFF]; }
+    if (address <= 0xFE9F) { return memory->oam_ram[address - 0xFE00]; } //OAM
+    if (address <= 0xFEFF) { return 0xFF; } //FEA0 - FEFF range prohibited
+
+    if ((address & 0xFF) >= 0x80 && (address & 0xFF) <= 0xFE)  { return memory->high_ram[address - 0xFF80]; } //high ram
+    else { return memory->interrupt_enable; } //IE register
 }
 
-void memory_write8(Memory* memory, uint16_t address, uint8_t data)
+void memory_write_unmapped(Memory* memory, uint16_t address, uint8_t data)
 {
     if (!memory) {
         fprintf(stderr, "[ERROR]: memory structure is NULL");
         abort();
     }
 
-    if (address >= 0x0 && address <= 0xFF && !memory->disable_bootrom)
+    if ((address & 0xFF80) == 0xFF00) { //I/O registers
+        memory->io_writes++;
+        IoRegister* reg = &memory->io_registers[address & 0x7F];
+        if (reg->write) { reg->write(reg->device, address, data); }
+        else { memory->io[address & 0x7F] = data; }
+        return;
+    }
+    if (memory->dma_active && address < 0xFF00) { return; } //OAM DMA holds the bus
+
+    if (address <= 0x7FFF) { //ROM from cartridge: MBC registers
+        memory->io_writes++;
+        Cartridge* cartridge = memory->cartridge;
+        const uint8_t* rom0 = cartridge->rom0;
+        const uint8_t* romx = cartridge->romx;
+        const uint8_t* ram = cartridge->ram_mapped;
+        cartridge_write(cartridge, address, data);
+        if (rom0 != cartridge->rom0 || romx != cartridge->romx || ram != cartridge->ram_mapped) { memory_map_cartridge(memory); }
+        if (memory->block_cache && (rom0 != cartridge->rom0 || romx != cartridge->romx)) { block_cache_rom_bank_switched(memory->block_cache); }
         return;
-    
-    switch (address & 0xF000) {
-        //ROM from cartridge
-        case 0x0000:
-        case 0x1000:
-        case 0x2000:
-        case 0x3000:
-        case 0x4000:
-        case 0x5000:
-        case 0x6000:
-        case 0x7000: { cartridge_write(memory->cartridge, address, data); return; }
-
-        //VRAM ppu
-        case 0x8000:
-        case 0x9000: { return ; } //TODO ppu_write(ppu, address)
-
-        //EXTERNAL RAM from cartridge
-        case 0xA000:
-        case 0xB000: { cartridge_write(memory->cartridge, address, data); return; }
-
-        //WORK RAM
-        case 0xC000:
-        case 0xD000: { memory->work_ram[address & 0x1FFF] = data; return; }
-        
-        //echo work ram
-        case 0xE000: { memory->work_ram[address & 0x1FFF] = data; return; }
-
-        case 0xF000: switch (address & 0x0F00) {
-            //echo work ram
-            case 0x000:
-            case 0x100:
-            case 0x200:
-            case 0x300:
-            case 0x400:
-            case 0x500:
-            case 0x600:
-            case 0x700:
-            case 0x800:
-            case 0x900:
-            case 0xA00:
-            case 0xB00:
-            case 0xC00:
-            case 0xD00: { memory->work_ram[address & 0x1FFF] = data; return; }
-
-            case 0xE00: switch (address & 0x00F0) {
-                //OAM
-                case 0x00:
-                case 0x10:
-                case 0x20:
-                case 0x30:
-                case 0x40:
-                case 0x50:
-                case 0x60:
-                case 0x70:
-                case 0x80:
-                case 0x90: { memory->oam_ram[address - 0xFE00] = data; return; }
-
-                //FEA0 - FEFF range prohibited
-                default: { return; }
-            }
-
-            case 0xF00: {
-                if ((address & 0xFF) >= 0x00 && (address & 0xFF) <= 0x7F) { //I/O registers
-                    if (address == 0xFF00) { joypad_write(memory->joypad, address, data); }
-                    else if ((address >= 0xFF01) && (address <= 0xFF02)) { serial_write(memory->serial, address, data); }
-                    else if ((address >= 0xFF04) && (address <= 0xFF07)) { timer_write(memory->timer, address, data); }
-                    else if (address == 0xFF0F) { memory->interrupt_requested = (data | 0xE0); }
-                    else if ((address >= 0xFF40) && (address <= 0xFF4B)) {  } //TODO return ppu_write(ppu, address)}
-                    else if (address == 0xFF50) { memory->disable_bootrom = data; }
-                    else { return; }
-                } 
-                else if ((address & 0xFF) >= 0x80 && (address & 0xFF) <= 0xFE)  { memory->high_ram[address - 0xFF80] = data; } //high ram
-                else { memory->interrupt_enable = (data | 0xE0); } //IE register
-                return;
-            }
-
-            default: { return; }
-        }
-        default: { return; }
     }
-    
+    if (address <= 0x9FFF) { memory->io_writes++; ppu_write_vram(memory->ppu, address, data); return; } //VRAM
+    if (address <= 0xBFFF) { memory->io_writes++; cartridge_write(memory->cartridge, address, data); return; } //EXTERNAL RAM
+    if (address <= 0xFDFF) { memory->work_ram[address & 0x1FFF] = data; block_cache_write_notify(memory->block_cache, address & 0x1FFF); return; }
+    if (address <= 0xFE9F) { ppu_write_oam(memory->ppu, address, data); return; } //OAM, the ppu keeps its sprite index in step
+    if (address <= 0xFEFF) { return; } //FEA0 - FEFF range prohibited
+
+    if ((address & 0xFF) >= 0x80 && (address & 0xFF) <= 0xFE)  { memory->high_ram[address - 0xFF80] = data; block_cache_write_notify(memory->block_cache, WORKRAM_SIZE + (address - 0xFF80)); } //high ram
+    else { memory->interrupt_enable = (data | 0xE0); memory_update_interrupt_pending(memory); } //IE register
+}
+
+//put the boot ROM over 0x0000-0x00FF for a power on boot, before the cpu runs
+void memory_map_boot_rom(Memory* memory)
+{
+    if (!memory) { abort(); }
+
+    memory->bootrom_mapped = true;
+    memory_read_pages(memory)[0x00] = bootRom;
+}
+
+//EVENT_DMA: the transfer is over, the page tables come back with the mapping changes made meanwhile
+void memory_dma_end(Memory* memory)
+{
+    if (!memory) { abort(); }
+
+    if (!memory->dma_active) { return; }
+    memcpy(memory->read_page, memory->dma_read_page, sizeof(memory->read_page));
+    memcpy(memory->write_page, memory->dma_write_page, sizeof(memory->write_page));
+    memory->dma_active = false;
+}
+
+//the write page of a work ram page holding cached code is removed, its writes go through memory_write_unmapped
+void memory_write_protect(Memory* memory, uint16_t address, bool protect)
+{
+    if (!memory) { abort(); }
+
+    uint16_t offset = address & 0x1F00;
+    uint8_t** write_page = memory_write_pages(memory);
+    write_page[0xC0 + (offset >> 8)] = (protect) ? NULL : &memory->work_ram[offset];
+    if (0xE0 + (offset >> 8) < 0xFE) { write_page[0xE0 + (offset >> 8)] = (protect) ? NULL : &memory->work_ram[offset]; } //echo
 }
 
 uint16_t memory_read16(Memory* memory, uint16_t address)
@@ -279,4 +352,21 @@ void memory_write16(Memory* memory,uint16_t address, uint16_t data)
 
     memory_write8(memory, address, (data & 0xFF));
     memory_write8(memory, (address + 1), ((data >> 8) & 0xFF));
-}
\ No newline at end of file
+}
+
+//set IF bits from a peripheral
+void memory_request_interrupt(Memory* memory, uint8_t interrupt)
+{
+    if (!memory) { abort(); }
+
+    memory->interrupt_requested |= interrupt;
+    memory_update_interrupt_pending(memory);
+}
+
+//to call after any change of interrupt_requested or interrupt_enable
+void memory_update_interrupt_pending(Memory* memory)
+{
+    if (!memory) { abort(); }
+
+    memory->interrupt_pending = memory->interrupt_enable & memory->interrupt_requested & 0x1F;
+}
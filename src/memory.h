@@ -2,34 +2,106 @@
 #define __MEMORY_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "scheduler.h"
 #include "timer.h"
 #include "serial.h"
 #include "cartridge.h"
 #include "joypad.h"
+#include "ppu.h"
 
 #define WORKRAM_SIZE 0x2000
 #define HIGHRAM_SIZE 0x7F
 #define OAMRAM_SIZE 0xA0
+#define IO_SIZE 0x80
+#define DMA_CYCLES 640 //160 bytes, one per machine cycle
 
+typedef enum {
+    BOOT_ROM, //power on state, the boot ROM runs from 0x0000 and unmaps itself through FF50
+    BOOT_INSTANT //start at 0x0100 from the state the boot ROM leaves, the boot ROM is never mapped
+} BootMode;
+
+typedef uint8_t (*IoReadHandler)(void* device, uint16_t address);
+typedef void (*IoWriteHandler)(void* device, uint16_t address, uint8_t data);
+
+//one I/O register of FF00-FF7F
+typedef struct {
+    IoReadHandler read; //NULL: read the backing byte
+    IoWriteHandler write; //NULL: write the backing byte
+    void* device; //first argument of the handlers
+    uint8_t read_mask; //unused bits, they read as 1
+} IoRegister;
+
+struct BlockCache;
+
+//the state read on every access comes first, then the page tables, the RAM arrays start on their own cache lines
 typedef struct {
     uint8_t interrupt_requested; //IF - FF0F
     uint8_t interrupt_enable; //IE - FFFF
-    uint8_t disable_bootrom; //FF50
+    uint8_t interrupt_pending; //IE & IF & 0x1F, updated on every change of IE or IF
+    bool bootrom_mapped; //boot ROM overlay on page 0x00, until the first write to FF50
+    bool dma_active; //OAM DMA blocks the bus: only I/O, HRAM and IE answer, the page tables are set aside in dma_*_page
+    uint8_t dma; //FF46, source page of the last OAM DMA
+    uint32_t io_writes; //writes outside WRAM/HRAM/OAM, they have side effects
+    uint32_t writes; //every write
+    uint32_t clock_reads; //reads of DIV/TIMA, their value changes with time alone
+    uint32_t ly_reads; //reads of LY, its value changes at the line boundaries of the PPU only
+    uint32_t stat_reads; //reads of STAT, its value changes at the line and mode boundaries
 
-    uint8_t work_ram[WORKRAM_SIZE];
-    uint8_t high_ram[HIGHRAM_SIZE];
-    uint8_t oam_ram[OAMRAM_SIZE];
+    Scheduler* scheduler;
     Timer* timer;
     Serial* serial;
     Joypad* joypad;
     Cartridge* cartridge;
+    Ppu* ppu;
+    struct BlockCache* block_cache; //invalidated on writes to WRAM/HRAM code and on ROM bank switches, NULL if unused
+
+    //one entry per 256 bytes page: host address of the page, NULL if its accesses go through memory_read_unmapped/memory_write_unmapped
+    const uint8_t* read_page[0x100];
+    uint8_t* write_page[0x100];
+
+    uint8_t high_ram[HIGHRAM_SIZE] __attribute__((aligned(64)));
+    uint8_t io[IO_SIZE] __attribute__((aligned(64))); //backing bytes of the I/O registers without handlers
+    IoRegister io_registers[IO_SIZE];
+    uint8_t oam_ram[OAMRAM_SIZE] __attribute__((aligned(64)));
+    uint8_t work_ram[WORKRAM_SIZE] __attribute__((aligned(64)));
+
+    const uint8_t* dma_read_page[0x100]; //the page tables while OAM DMA runs, the mapping changes meanwhile land here
+    uint8_t* dma_write_page[0x100];
 } Memory;
 
 
-void memory_init(Memory* memory, Serial* serial, Timer* timer, Joypad* joypad, Cartridge* cartridge);
-uint8_t memory_read8(Memory* memory, uint16_t address);
-void memory_write8(Memory* memory, uint16_t address, uint8_t data);
+void memory_init(Memory* memory, Scheduler* scheduler, Serial* serial, Timer* timer, Joypad* joypad, Cartridge* cartridge, Ppu* ppu);
+uint8_t memory_read_unmapped(Memory* memory, uint16_t address);
+void memory_write_unmapped(Memory* memory, uint16_t address, uint8_t data);
+void memory_write_protect(Memory* memory, uint16_t address, bool protect);
+void memory_map_boot_rom(Memory* memory);
+void memory_dma_end(Memory* memory);
+void memory_io_register(Memory* memory, uint16_t address, IoReadHandler read, IoWriteHandler write, void* device, uint8_t read_mask);
 uint16_t memory_read16(Memory* memory, uint16_t address);
 void memory_write16(Memory* memory,uint16_t address, uint16_t data);
 
+void memory_request_interrupt(Memory* memory, uint8_t interrupt);
+void memory_update_interrupt_pending(Memory* memory);
+
+//direct load from the page table, the other regions are decoded by memory_read_unmapped
+static inline uint8_t memory_read8(Memory* memory, uint16_t address)
+{
+    const uint8_t* page = memory->read_page[address >> 8];
+    if (page) { return page[address & 0xFF]; }
+
+    return memory_read_unmapped(memory, address);
+}
+
+//only the work ram pages without cached code have a write page
+static inline void memory_write8(Memory* memory, uint16_t address, uint8_t data)
+{
+    memory->writes++;
+
+    uint8_t* page = memory->write_page[address >> 8];
+    if (page) { page[address & 0xFF] = data; return; }
+
+    memory_write_unmapped(memory, address, data);
+}
+
 #endif //__MEMORY_H__
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "ppu.h"
+#include "hard_registers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PPU_SIMD 1
+#else
+#define PPU_SIMD 0
+#endif
+
+void ppu_init(Ppu* ppu, uint8_t* oam, Scheduler* scheduler)
+{
+    if (!ppu || !oam || !scheduler) { fprintf(stderr, "[ERROR]: ppu initialization failed from structure element"); abort(); }
+
+    ppu->oam = oam;
+    ppu->scheduler = scheduler;
+    ppu->compose = ppu_compose_scalar;
+#if PPU_SIMD
+    if (__builtin_cpu_supports("avx2")) { ppu->compose = ppu_compose_avx2; }
+    else if (__builtin_cpu_supports("ssse3")) { ppu->compose = ppu_compose_ssse3; }
+#endif
+    ppu->lcdc = 0;
+    ppu->stat = 0;
+    ppu->scy = 0;
+    ppu->scx = 0;
+    ppu->lyc = 0;
+    ppu->bgp = 0;
+    ppu->obp[0] = 0;
+    ppu->obp[1] = 0;
+    ppu->wy = 0;
+    ppu->wx = 0;
+    ppu->window_line = 0;
+    ppu->interrupt = 0;
+    ppu->frame_ready = false;
+    ppu->lcd_origin = scheduler->now;
+    ppu->next_boundary = EVENT_NEVER;
+    memset(ppu->vram, 0, sizeof(uint8_t) * VRAM_SIZE);
+    memset(ppu->tiles, 0, sizeof(ppu->tiles)); //what the cleared VRAM decodes to
+    memset(ppu->framebuffer, 0, sizeof(ppu->framebuffer));
+    ppu_index_objects(ppu);
+}
+
+//the LCD is off at power on, the boot ROM turns it on
+void ppu_power_on(Ppu* ppu)
+{
+    if (!ppu) { abort(); }
+
+    ppu_write(ppu, LCDC, 0x00);
+}
+
+//cycles since the start of the current frame, the LCD is on
+static uint32_t ppu_frame_cycle(Ppu* ppu, uint64_t when)
+{
+    return (when - ppu->lcd_origin) % FRAME_CYCLES;
+}
+
+static uint8_t ppu_mode(uint32_t cycle)
+{
+    if (cycle >= SCREEN_HEIGHT * LINE_CYCLES) { return 1; }
+    uint32_t dot = cycle % LINE_CYCLES;
+    if (dot < MODE2_CYCLES) { return 2; }
+    if (dot < MODE2_CYCLES + MODE3_CYCLES) { return 3; }
+    return 0;
+}
+
+//the STAT interrupt sources ORed together at when, the interrupt is requested on the rising edges only
+static bool ppu_stat_line(Ppu* ppu, uint64_t when)
+{
+    if (!(ppu->lcdc & LCDC_ENABLE)) { return false; }
+
+    uint32_t cycle = ppu_frame_cycle(ppu, when);
+    uint8_t mode = ppu_mode(cycle);
+    return ((ppu->stat & STAT_HBLANK_IRQ) && mode == 0) || ((ppu->stat & STAT_VBLANK_IRQ) && mode == 1) ||
+           ((ppu->stat & STAT_OAM_IRQ) && mode == 2) || ((ppu->stat & STAT_LYC_IRQ) && cycle / LINE_CYCLES == ppu->lyc);
+}
+
+//first timestamp after when that is offset cycles into one of the lines first to last
+static uint64_t ppu_next_at(Ppu* ppu, uint64_t when, uint32_t offset, uint32_t first, uint32_t last)
+{
+    uint32_t cycle = ppu_frame_cycle(ppu, when);
+    uint64_t frame_start = when - cycle;
+
+    uint32_t line = first;
+    if (line * LINE_CYCLES + offset <= cycle) { line = (cycle - offset) / LINE_CYCLES + 1; }
+    if (line <= last) { return frame_start + line * LINE_CYCLES + offset; }
+    return frame_start + FRAME_CYCLES + first * LINE_CYCLES + offset;
+}
+
+static uint64_t ppu_min(uint64_t a, uint64_t b) { return (a < b) ? a : b; }
+
+//first timestamp after when where LY reads back something else, the next line, or STAT with modes, the next line or mode.
+//EVENT_NEVER while the LCD is off
+uint64_t ppu_next_change(Ppu* ppu, uint64_t when, bool modes)
+{
+    if (!ppu) { abort(); }
+    if (!(ppu->lcdc & LCDC_ENABLE)) { return EVENT_NEVER; }
+
+    uint64_t next = ppu_next_at(ppu, when, 0, 0, LINE_COUNT - 1);
+    if (!modes) { return next; }
+    next = ppu_min(next, ppu_next_at(ppu, when, MODE2_CYCLES, 0, SCREEN_HEIGHT - 1));
+    return ppu_min(next, ppu_next_at(ppu, when, MODE2_CYCLES + MODE3_CYCLES, 0, SCREEN_HEIGHT - 1));
+}
+
+//the next boundary after when with something to do: an HBlank to draw its line, VBlank, or where the STAT line may rise.
+//The mode 0 and mode 1 sources rise on the first two, the others only need their own boundary when enabled
+static void ppu_reschedule(Ppu* ppu, uint64_t when)
+{
+    ppu->next_boundary = EVENT_NEVER;
+    if (ppu->lcdc & LCDC_ENABLE) {
+        uint64_t next = ppu_next_at(ppu, when, MODE2_CYCLES + MODE3_CYCLES, 0, SCREEN_HEIGHT - 1);
+        next = ppu_min(next, ppu_next_at(ppu, when, 0, SCREEN_HEIGHT, SCREEN_HEIGHT));
+        if (ppu->stat & STAT_OAM_IRQ) { next = ppu_min(next, ppu_next_at(ppu, when, 0, 0, SCREEN_HEIGHT - 1)); }
+        if ((ppu->stat & STAT_LYC_IRQ) && ppu->lyc < LINE_COUNT) { next = ppu_min(next, ppu_next_at(ppu, when, 0, ppu->lyc, ppu->lyc)); }
+        ppu->next_boundary = next;
+    }
+    scheduler_schedule(ppu->scheduler, EVENT_PPU, ppu->next_boundary);
+}
+
+//EVENT_PPU at a boundary: the line whose HBlank starts is drawn, VBlank completes the frame, and the STAT
+//interrupt is requested if its line rose. An early event only delivers the interrupt of a register write
+void ppu_event(Ppu* ppu)
+{
+    if (!ppu) { abort(); }
+
+    uint64_t when = ppu->next_boundary;
+    if (when > ppu->scheduler->now) { scheduler_schedule(ppu->scheduler, EVENT_PPU, when); return; }
+
+    uint32_t cycle = ppu_frame_cycle(ppu, when);
+    uint8_t line = cycle / LINE_CYCLES;
+    if (line < SCREEN_HEIGHT && cycle % LINE_CYCLES == MODE2_CYCLES + MODE3_CYCLES) { ppu_render_line(ppu, line); }
+    if (cycle == SCREEN_HEIGHT * LINE_CYCLES) {
+        ppu->interrupt |= 0x1;
+        ppu->frame_ready = true;
+        ppu->window_line = 0;
+    }
+    if (!ppu_stat_line(ppu, when - 1) && ppu_stat_line(ppu, when)) { ppu->interrupt |= 0x2; }
+
+    ppu_reschedule(ppu, when);
+}
+
+uint8_t ppu_read(Ppu* ppu, uint16_t address)
+{
+    if (!ppu) { abort(); }
+
+    switch (address) {
+        case LCDC: { return ppu->lcdc; }
+        case STAT: {
+            if (!(ppu->lcdc & LCDC_ENABLE)) { return ppu->stat | ((ppu->lyc == 0) ? STAT_COINCIDENCE : 0); } //LY 0 in mode 0
+            uint32_t cycle = ppu_frame_cycle(ppu, ppu->scheduler->now);
+            return ppu->stat | ((cycle / LINE_CYCLES == ppu->lyc) ? STAT_COINCIDENCE : 0) | ppu_mode(cycle);
+        }
+        case SCY: { return ppu->scy; }
+        case SCX: { return ppu->scx; }
+        case LY: { return (ppu->lcdc & LCDC_ENABLE) ? ppu_frame_cycle(ppu, ppu->scheduler->now) / LINE_CYCLES : 0; }
+        case LYC: { return ppu->lyc; }
+        case BGP: { return ppu->bgp; }
+        case OBP0: { return ppu->obp[0]; }
+        case OBP1: { return ppu->obp[1]; }
+        case WY: { return ppu->wy; }
+        case WX: { return ppu->wx; }
+        default: { fprintf(stderr, "[ERROR]: invalid address to read ppu"); abort(); }
+    }
+}
+
+//LCDC, STAT and LYC change the STAT line: enabling a source that is already active requests the interrupt at once
+void ppu_write(Ppu* ppu, uint16_t address, uint8_t data)
+{
+    if (!ppu) { abort(); }
+
+    uint64_t now = ppu->scheduler->now;
+    switch (address) {
+        case LCDC: case STAT: case LYC: { break; }
+        case SCY: { ppu->scy = data; return; }
+        case SCX: { ppu->scx = data; return; }
+        case LY: { return; } //read only
+        case BGP: { ppu->bgp = data; return; }
+        case OBP0: { ppu->obp[0] = data; return; }
+        case OBP1: { ppu->obp[1] = data; return; }
+        case WY: { ppu->wy = data; return; }
+        case WX: { ppu->wx = data; return; }
+        default: { fprintf(stderr, "[ERROR]: invalid address to write ppu"); abort(); }
+    }
+
+    bool stat_line = ppu_stat_line(ppu, now);
+    if (address == LCDC) {
+        if ((data & LCDC_ENABLE) && !(ppu->lcdc & LCDC_ENABLE)) { //a new frame starts at line 0
+            ppu->lcd_origin = now;
+            ppu->window_line = 0;
+        }
+        uint8_t changed = ppu->lcdc ^ data;
+        ppu->lcdc = data;
+        if (changed & LCDC_OBJ_TALL) { ppu_index_objects(ppu); }
+    }
+    else if (address == STAT) { ppu->stat = data & 0x78; } //mode and coincidence bits are read only
+    else { ppu->lyc = data; }
+
+    if (!stat_line && ppu_stat_line(ppu, now)) { ppu->interrupt |= 0x2; }
+    ppu_reschedule(ppu, now);
+    if (ppu->interrupt) { scheduler_schedule(ppu->scheduler, EVENT_PPU, now); }
+}
+
+//bit 7 - i of a byte to byte i of the result, the leftmost pixel first
+static uint64_t ppu_spread_bits(uint8_t bits)
+{
+    return ((bits * 0x8040201008040201ULL) >> 7) & 0x0101010101010101ULL;
+}
+
+//2 bits per pixel over two planes: the first byte of the row holds bit 0 of the 8 pixels, the second byte bit 1
+static void ppu_decode_row(uint8_t* pixels, uint8_t low, uint8_t high)
+{
+    uint64_t row = ppu_spread_bits(low) | (ppu_spread_bits(high) << 1);
+    memcpy(pixels, &row, 8);
+}
+
+//0xFF in each byte that is not 0, for bytes below 0x80
+static uint64_t ppu_nonzero_bytes(uint64_t bytes)
+{
+    return (((bytes + 0x7F7F7F7F7F7F7F7FULL) & 0x8080808080808080ULL) >> 7) * 0xFF;
+}
+
+//reads go through the read pages, the writes come here to keep the decoded tiles in step
+void ppu_write_vram(Ppu* ppu, uint16_t address, uint8_t data)
+{
+    if (!ppu) { abort(); }
+
+    uint16_t offset = address & (VRAM_SIZE - 1);
+    if (ppu->vram[offset] == data) { return; }
+    ppu->vram[offset] = data;
+
+    if (offset < TILE_COUNT * 16) { //tile data, the rest are the two tile maps
+        uint16_t row = offset & ~0x1;
+        ppu_decode_row(ppu->tiles[offset >> 4][(offset >> 1) & 0x7], ppu->vram[row], ppu->vram[row + 1]);
+    }
+}
+
+//tile number from a map to its index in tiles: 0x8000 addressing, or 0x9000 with a signed number
+static const uint8_t* ppu_tile_row(Ppu* ppu, uint8_t tile, uint8_t row)
+{
+    uint16_t index = (ppu->lcdc & LCDC_TILE_DATA || tile >= 0x80) ? tile : 0x100 + tile;
+    return ppu->tiles[index][row];
+}
+
+//copy count tile rows of the map line at map_y, starting at column map_x, to line
+static void ppu_copy_map_row(Ppu* ppu, uint8_t* line, uint16_t map, uint8_t map_x, uint8_t map_y, uint8_t count)
+{
+    const uint8_t* tiles = &ppu->vram[map + (map_y >> 3) * 32];
+    for (uint8_t i = 0; i < count; i++) {
+        memcpy(line + i * 8, ppu_tile_row(ppu, tiles[(map_x + i) & 0x1F], map_y & 0x7), 8);
+    }
+}
+
+static uint8_t ppu_object_height(Ppu* ppu)
+{
+    return (ppu->lcdc & LCDC_OBJ_TALL) ? 16 : 8;
+}
+
+//set or clear the bit of sprite i on the screen lines a Y byte of y covers
+static void ppu_index_object(Ppu* ppu, uint8_t i, uint8_t y, bool covers)
+{
+    int16_t top = y - 16;
+    int16_t bottom = top + ppu_object_height(ppu);
+    if (top < 0) { top = 0; }
+    if (bottom > SCREEN_HEIGHT) { bottom = SCREEN_HEIGHT; }
+
+    uint64_t bit = 1ULL << i;
+    for (int16_t line = top; line < bottom; line++) {
+        if (covers) { ppu->line_objects[line] |= bit; }
+        else { ppu->line_objects[line] &= ~bit; }
+    }
+}
+
+//the whole index from OAM, when the sprite height changes or OAM is replaced at once
+void ppu_index_objects(Ppu* ppu)
+{
+    if (!ppu) { abort(); }
+
+    memset(ppu->line_objects, 0, sizeof(ppu->line_objects));
+    for (uint8_t i = 0; i < OBJ_COUNT; i++) { ppu_index_object(ppu, i, ppu->oam[i * 4], true); }
+}
+
+//only a new Y moves a sprite to other lines, X and the attributes are read when the line is drawn
+void ppu_write_oam(Ppu* ppu, uint16_t address, uint8_t data)
+{
+    if (!ppu) { abort(); }
+
+    uint8_t offset = address - 0xFE00;
+    if (ppu->oam[offset] == data) { return; }
+    if (offset & 0x3) { ppu->oam[offset] = data; return; }
+
+    ppu_index_object(ppu, offset >> 2, ppu->oam[offset], false);
+    ppu->oam[offset] = data;
+    ppu_index_object(ppu, offset >> 2, data, true);
+}
+
+//the whole OAM from an OAM DMA in one copy, only the sprites given a new Y move in the index
+void ppu_dma_oam(Ppu* ppu, const uint8_t* source)
+{
+    if (!ppu || !source) { abort(); }
+
+    for (uint8_t i = 0; i < OBJ_COUNT; i++) {
+        if (ppu->oam[i * 4] == source[i * 4]) { continue; }
+        ppu_index_object(ppu, i, ppu->oam[i * 4], false);
+        ppu_index_object(ppu, i, source[i * 4], true);
+    }
+    memcpy(ppu->oam, source, OBJ_COUNT * 4);
+}
+
+//up to 10 sprites on the line in OAM order, sorted by drawing priority: lower X first, then lower OAM index
+static uint8_t ppu_select_objects(Ppu* ppu, uint8_t line, uint8_t* selected)
+{
+    uint8_t count = 0;
+    for (uint64_t candidates = ppu->line_objects[line]; candidates && count < OBJ_PER_LINE; candidates &= candidates - 1) {
+        uint8_t i = __builtin_ctzll(candidates);
+        uint8_t at = count++;
+        while (at > 0 && ppu->oam[selected[at - 1] * 4 + 1] > ppu->oam[i * 4 + 1]) { selected[at] = selected[at - 1]; at--; }
+        selected[at] = i;
+    }
+    return count;
+}
+
+void ppu_render_line(Ppu* ppu, uint8_t line)
+{
+    if (!ppu || line >= SCREEN_HEIGHT) { abort(); }
+
+    uint8_t* out = ppu->framebuffer[line];
+    if (!(ppu->lcdc & LCDC_ENABLE)) { memset(out, 0, SCREEN_WIDTH); return; }
+
+    //color indexes of background and window, 8 pixels of margin on both sides for the scroll and the window start
+    uint8_t pixels[8 + 8 + SCREEN_WIDTH + 8 + 8] __attribute__((aligned(16)));
+    uint8_t* bg = pixels + 8 + (ppu->scx & 0x7);
+
+    if (ppu->lcdc & LCDC_BG_ENABLE) { //on DMG it also hides the window
+        uint8_t y = line + ppu->scy;
+        ppu_copy_map_row(ppu, pixels + 8, (ppu->lcdc & LCDC_BG_MAP) ? 0x1C00 : 0x1800, ppu->scx >> 3, y, SCREEN_WIDTH / 8 + 1);
+
+        if ((ppu->lcdc & LCDC_WINDOW_ENABLE) && line >= ppu->wy && ppu->wx <= 166) {
+            int16_t x = ppu->wx - 7;
+            ppu_copy_map_row(ppu, bg + x, (ppu->lcdc & LCDC_WINDOW_MAP) ? 0x1C00 : 0x1800, 0, ppu->window_line, (SCREEN_WIDTH - x + 7) / 8);
+            ppu->window_line++;
+        }
+    }
+    else { memset(bg, 0, SCREEN_WIDTH); }
+
+    //sprites first in priority order, a pixel keeps the first opaque one
+    uint8_t obj[8 + SCREEN_WIDTH + 8 + 8] __attribute__((aligned(16))) = { 0 };
+    if (ppu->lcdc & LCDC_OBJ_ENABLE) {
+        uint8_t height = ppu_object_height(ppu);
+        uint8_t selected[OBJ_PER_LINE];
+        uint8_t count = ppu_select_objects(ppu, line, selected);
+
+        for (uint8_t i = 0; i < count; i++) { //8 pixels at once, obj has room for the sprites partly off screen
+            const uint8_t* entry = &ppu->oam[selected[i] * 4];
+            if (entry[1] >= SCREEN_WIDTH + 8) { continue; } //off screen, it still counted in the 10
+            uint8_t row = line - (entry[0] - 16);
+            if (entry[3] & OBJ_YFLIP) { row = height - 1 - row; }
+            uint8_t tile = (height == 16) ? ((entry[2] & 0xFE) | (row >> 3)) : entry[2];
+
+            uint64_t pixels_obj;
+            memcpy(&pixels_obj, ppu->tiles[tile][row & 0x7], 8);
+            if (entry[3] & OBJ_XFLIP) { pixels_obj = __builtin_bswap64(pixels_obj); }
+            uint64_t opaque = ppu_nonzero_bytes(pixels_obj);
+            uint64_t attributes = ((entry[3] & OBJ_PALETTE) ? 0x04 : 0x00) | ((entry[3] & OBJ_BEHIND_BG) ? 0x08 : 0x00);
+            pixels_obj |= opaque & (attributes * 0x0101010101010101ULL);
+
+            uint64_t drawn;
+            memcpy(&drawn, &obj[entry[1]], 8);
+            drawn |= pixels_obj & opaque & ~ppu_nonzero_bytes(drawn);
+            memcpy(&obj[entry[1]], &drawn, 8);
+        }
+    }
+
+    uint8_t bg_shades[16] __attribute__((aligned(16))) = { 0 }; //the palettes as byte tables for the compose pass
+    uint8_t obj_shades[16] __attribute__((aligned(16))) = { 0 };
+    for (uint8_t color = 0; color < 4; color++) {
+        bg_shades[color] = (ppu->bgp >> (color * 2)) & 0x3;
+        obj_shades[color] = (ppu->obp[0] >> (color * 2)) & 0x3;
+        obj_shades[4 + color] = (ppu->obp[1] >> (color * 2)) & 0x3;
+    }
+    ppu->compose(out, bg, obj + 8, bg_shades, obj_shades);
+}
+
+void ppu_compose_scalar(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades)
+{
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x++) {
+        bool hidden = !(obj[x] & 0x3) || ((obj[x] & 0x8) && bg[x]);
+        out[x] = hidden ? bg_shades[bg[x]] : obj_shades[obj[x] & 0x7];
+    }
+}
+
+#if PPU_SIMD
+//the shade tables are looked up with pshufb, 16 pixels per step
+__attribute__((target("ssse3")))
+void ppu_compose_ssse3(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades)
+{
+    const __m128i bg_table = _mm_load_si128((const __m128i*)bg_shades);
+    const __m128i obj_table = _mm_load_si128((const __m128i*)obj_shades);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x += 16) {
+        __m128i colors = _mm_loadu_si128((const __m128i*)&bg[x]);
+        __m128i sprites = _mm_loadu_si128((const __m128i*)&obj[x]);
+        __m128i transparent = _mm_cmpeq_epi8(_mm_and_si128(sprites, _mm_set1_epi8(0x3)), zero);
+        __m128i behind = _mm_andnot_si128(_mm_cmpeq_epi8(colors, zero), _mm_cmpeq_epi8(_mm_and_si128(sprites, _mm_set1_epi8(0x8)), _mm_set1_epi8(0x8)));
+        __m128i hidden = _mm_or_si128(transparent, behind);
+        __m128i shades = _mm_shuffle_epi8(bg_table, colors);
+        __m128i obj_colors = _mm_shuffle_epi8(obj_table, _mm_and_si128(sprites, _mm_set1_epi8(0x7)));
+        _mm_storeu_si128((__m128i*)&out[x], _mm_or_si128(_mm_and_si128(hidden, shades), _mm_andnot_si128(hidden, obj_colors)));
+    }
+}
+
+//the same on 32 pixels per step, 160 = 5 x 32
+__attribute__((target("avx2")))
+void ppu_compose_avx2(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades)
+{
+    const __m256i bg_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)bg_shades)); //pshufb looks up in each 128 bits lane
+    const __m256i obj_table = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)obj_shades));
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (uint8_t x = 0; x < SCREEN_WIDTH; x += 32) {
+        __m256i colors = _mm256_loadu_si256((const __m256i*)&bg[x]);
+        __m256i sprites = _mm256_loadu_si256((const __m256i*)&obj[x]);
+        __m256i transparent = _mm256_cmpeq_epi8(_mm256_and_si256(sprites, _mm256_set1_epi8(0x3)), zero);
+        __m256i behind = _mm256_andnot_si256(_mm256_cmpeq_epi8(colors, zero), _mm256_cmpeq_epi8(_mm256_and_si256(sprites, _mm256_set1_epi8(0x8)), _mm256_set1_epi8(0x8)));
+        __m256i hidden = _mm256_or_si256(transparent, behind);
+        __m256i shades = _mm256_shuffle_epi8(bg_table, colors);
+        __m256i obj_colors = _mm256_shuffle_epi8(obj_table, _mm256_and_si256(sprites, _mm256_set1_epi8(0x7)));
+        _mm256_storeu_si256((__m256i*)&out[x], _mm256_blendv_epi8(obj_colors, shades, hidden));
+    }
+}
+#endif
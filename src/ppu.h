@@ -0,0 +1,101 @@
+#ifndef __PPU_H__
+#define __PPU_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "scheduler.h"
+
+#define VRAM_SIZE 0x2000
+#define TILE_COUNT 384 //0x8000-0x97FF, 16 bytes each
+#define SCREEN_WIDTH 160
+#define SCREEN_HEIGHT 144
+#define OBJ_PER_LINE 10
+#define OBJ_COUNT 40
+
+//a line is 80 cycles of OAM scan (mode 2), 172 of drawing (mode 3) and the rest of HBlank (mode 0),
+//the 10 lines after the screen are VBlank (mode 1)
+#define LINE_CYCLES 456
+#define LINE_COUNT 154
+#define FRAME_CYCLES (LINE_CYCLES * LINE_COUNT)
+#define MODE2_CYCLES 80
+#define MODE3_CYCLES 172
+
+//STAT bits
+#define STAT_MODE 0x03
+#define STAT_COINCIDENCE 0x04
+#define STAT_HBLANK_IRQ 0x08
+#define STAT_VBLANK_IRQ 0x10
+#define STAT_OAM_IRQ 0x20
+#define STAT_LYC_IRQ 0x40
+
+//LCDC bits
+#define LCDC_BG_ENABLE 0x01
+#define LCDC_OBJ_ENABLE 0x02
+#define LCDC_OBJ_TALL 0x04 //8x16 sprites
+#define LCDC_BG_MAP 0x08 //0x9C00 instead of 0x9800
+#define LCDC_TILE_DATA 0x10 //0x8000 unsigned instead of 0x9000 signed
+#define LCDC_WINDOW_ENABLE 0x20
+#define LCDC_WINDOW_MAP 0x40
+#define LCDC_ENABLE 0x80
+
+//OAM attribute bits
+#define OBJ_PALETTE 0x10
+#define OBJ_XFLIP 0x20
+#define OBJ_YFLIP 0x40
+#define OBJ_BEHIND_BG 0x80
+
+//final pass of a line: background shades, and the sprite pixels over them. obj holds 0 where no sprite is drawn,
+//else color (bits 0-1) | OBP1 (bit 2) | behind background (bit 3). The shade tables are indexed by bg and by obj & 0x7
+typedef void (*PpuCompose)(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades);
+
+//lines are composed from tiles kept decoded to one color index (0-3) per byte: drawing a tile row is an 8 bytes copy.
+//LY and the mode are derived from the scheduler clock when read, EVENT_PPU only fires where a line is drawn
+//or an interrupt may be requested
+typedef struct {
+    uint8_t lcdc;
+    uint8_t stat; //interrupt enable bits only, the mode and coincidence bits are computed
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t lyc;
+    uint8_t bgp;
+    uint8_t obp[2];
+    uint8_t wy;
+    uint8_t wx;
+    uint8_t window_line; //next line of the window, it only advances on the lines it is drawn
+
+    uint8_t interrupt;
+    bool frame_ready; //VBlank reached, the framebuffer is complete
+
+    Scheduler* scheduler;
+    uint64_t lcd_origin; //timestamp of the start of line 0 of the first frame since the LCD was turned on
+    uint64_t next_boundary; //timestamp EVENT_PPU handles next, EVENT_NEVER while the LCD is off
+
+    uint8_t* oam; //the 40 sprites of 4 bytes in memory, written through ppu_write_oam
+    PpuCompose compose; //widest version the host cpu runs, chosen by ppu_init
+
+    uint8_t vram[VRAM_SIZE] __attribute__((aligned(64)));
+    uint8_t tiles[TILE_COUNT][8][8] __attribute__((aligned(64))); //decoded again only when ppu_write_vram changes one of their rows
+    uint8_t framebuffer[SCREEN_HEIGHT][SCREEN_WIDTH] __attribute__((aligned(64))); //shades, 0 white to 3 black
+    uint64_t line_objects[SCREEN_HEIGHT] __attribute__((aligned(64))); //bit i: sprite i covers the line, follows the Y bytes and the sprite height
+} Ppu;
+
+void ppu_init(Ppu* ppu, uint8_t* oam, Scheduler* scheduler);
+void ppu_power_on(Ppu* ppu);
+uint8_t ppu_read(Ppu* ppu, uint16_t address);
+void ppu_write(Ppu* ppu, uint16_t address, uint8_t data);
+void ppu_write_vram(Ppu* ppu, uint16_t address, uint8_t data);
+void ppu_write_oam(Ppu* ppu, uint16_t address, uint8_t data);
+void ppu_dma_oam(Ppu* ppu, const uint8_t* source);
+void ppu_index_objects(Ppu* ppu);
+uint64_t ppu_next_change(Ppu* ppu, uint64_t when, bool modes);
+
+void ppu_compose_scalar(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades);
+#if defined(__x86_64__)
+void ppu_compose_ssse3(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades);
+void ppu_compose_avx2(uint8_t* out, const uint8_t* bg, const uint8_t* obj, const uint8_t* bg_shades, const uint8_t* obj_shades);
+#endif
+
+void ppu_render_line(Ppu* ppu, uint8_t line);
+void ppu_event(Ppu* ppu);
+
+#endif //__PPU_H__
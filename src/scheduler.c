@@ -0,0 +1,95 @@
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void scheduler_init(Scheduler* scheduler)
+{
+    if (!scheduler) { fprintf(stderr, "[ERROR]: scheduler initialization failed from structure element"); abort(); }
+
+    scheduler->now = 0;
+    scheduler->next = EVENT_NEVER;
+    scheduler->nbr_events = 0;
+    for (uint8_t i = 0; i < EVENT_COUNT; i++) { scheduler->when[i] = EVENT_NEVER; }
+}
+
+static void heap_swap(Scheduler* scheduler, uint8_t a, uint8_t b)
+{
+    uint8_t event = scheduler->heap[a];
+    scheduler->heap[a] = scheduler->heap[b];
+    scheduler->heap[b] = event;
+    scheduler->position[scheduler->heap[a]] = a;
+    scheduler->position[scheduler->heap[b]] = b;
+}
+
+static uint64_t heap_when(Scheduler* scheduler, uint8_t index)
+{
+    return scheduler->when[scheduler->heap[index]];
+}
+
+//move the event at index up or down until the heap is ordered again
+static void heap_fix(Scheduler* scheduler, uint8_t index)
+{
+    while (index > 0 && heap_when(scheduler, index) < heap_when(scheduler, (index - 1) / 2)) {
+        heap_swap(scheduler, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    while (true) {
+        uint8_t smallest = index;
+        uint8_t left = index * 2 + 1;
+        uint8_t right = index * 2 + 2;
+        if (left < scheduler->nbr_events && heap_when(scheduler, left) < heap_when(scheduler, smallest)) { smallest = left; }
+        if (right < scheduler->nbr_events && heap_when(scheduler, right) < heap_when(scheduler, smallest)) { smallest = right; }
+        if (smallest == index) { break; }
+        heap_swap(scheduler, index, smallest);
+        index = smallest;
+    }
+
+    scheduler->next = (scheduler->nbr_events) ? heap_when(scheduler, 0) : EVENT_NEVER;
+}
+
+//schedule the event at the timestamp when, or move it there if it is already scheduled
+void scheduler_schedule(Scheduler* scheduler, EventType event, uint64_t when)
+{
+    if (!scheduler || event >= EVENT_COUNT) { abort(); }
+
+    if (when == EVENT_NEVER) { scheduler_cancel(scheduler, event); return; }
+
+    if (scheduler->when[event] == EVENT_NEVER) {
+        scheduler->heap[scheduler->nbr_events] = event;
+        scheduler->position[event] = scheduler->nbr_events;
+        scheduler->nbr_events++;
+    }
+    scheduler->when[event] = when;
+    heap_fix(scheduler, scheduler->position[event]);
+}
+
+void scheduler_cancel(Scheduler* scheduler, EventType event)
+{
+    if (!scheduler || event >= EVENT_COUNT) { abort(); }
+
+    if (scheduler->when[event] == EVENT_NEVER) { return; }
+
+    uint8_t index = scheduler->position[event];
+    scheduler->nbr_events--;
+    scheduler->when[event] = EVENT_NEVER;
+    if (index != scheduler->nbr_events) {
+        heap_swap(scheduler, index, scheduler->nbr_events);
+        heap_fix(scheduler, index);
+    }
+    else {
+        scheduler->next = (scheduler->nbr_events) ? heap_when(scheduler, 0) : EVENT_NEVER;
+    }
+}
+
+//remove the earliest event if its timestamp is reached, the caller handles it (and may schedule it again)
+bool scheduler_pop_due(Scheduler* scheduler, EventType* event)
+{
+    if (!scheduler || !event) { abort(); }
+
+    if (scheduler->next > scheduler->now) { return false; }
+
+    *event = scheduler->heap[0];
+    scheduler_cancel(scheduler, *event);
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define EVENT_NEVER UINT64_MAX
+
+typedef enum {
+    EVENT_TIMER, //TIMA overflow
+    EVENT_SERIAL, //transfer complete
+    EVENT_FRAME, //70224 cycles without VBlank, the LCD is off: the frame is paced and the input is polled
+    EVENT_PPU, //HBlank or VBlank start, or a pending LCD interrupt
+    EVENT_DMA, //end of an OAM DMA, the bus is released
+    EVENT_COUNT
+} EventType;
+
+//events timestamped in cycles since power on, kept in a min-heap on their timestamp
+typedef struct Scheduler {
+    uint64_t now; //cycles since power on, advanced by the run loop after each instruction
+    uint64_t next; //timestamp of the earliest event, EVENT_NEVER if none: the cpu runs until now reaches it
+
+    uint64_t when[EVENT_COUNT]; //EVENT_NEVER if not scheduled
+    uint8_t heap[EVENT_COUNT]; //scheduled events, heap[0] is the earliest
+    uint8_t position[EVENT_COUNT]; //index in heap of each scheduled event
+    uint8_t nbr_events;
+} Scheduler;
+
+void scheduler_init(Scheduler* scheduler);
+void scheduler_schedule(Scheduler* scheduler, EventType event, uint64_t when);
+void scheduler_cancel(Scheduler* scheduler, EventType event);
+bool scheduler_pop_due(Scheduler* scheduler, EventType* event);
+
+#endif //__SCHEDULER_H__
@@ -9,9 +9,10 @@ static uint8_t serial_output_terminal(char c) {
     return 0;
 }
 
-void serial_init(Serial* serial) {
-    if (!serial) {abort();}
+void serial_init(Serial* serial, Scheduler* scheduler) {
+    if (!serial || !scheduler) {abort();}
 
+    serial->scheduler = scheduler;
     serial->sb = 0;
     serial->sc = 0;
     serial->interrupt = 0;
@@ -23,7 +24,8 @@ void serial_write(Serial* serial, uint16_t address, uint8_t data) {
     switch (address) {
         case 0xFF01: {serial->sb = data; break; }    
         case 0xFF02: { serial->sc = (data | 0x7E); 
-                        if (data & 0x81) { serial->sb = serial_output_terminal(serial->sb); serial->sc &= ~0x80; serial->interrupt = 0x8; };
+                        if (data & 0x81) { serial->sb = serial_output_terminal(serial->sb); serial->sc &= ~0x80; serial->interrupt = 0x8;
+                                           scheduler_schedule(serial->scheduler, EVENT_SERIAL, serial->scheduler->now); }; //the transfer completes at once
                         break; } //get only bit7et bit0 from data, useless bit set to 1
         default: { fprintf(stderr, "Error invalid address for serial"); abort(); }
     }
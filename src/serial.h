@@ -3,14 +3,17 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "scheduler.h"
 
 typedef struct {
     uint8_t sb;
     uint8_t sc;
     uint8_t interrupt;
+
+    Scheduler* scheduler;
 } Serial;
 
-void serial_init(Serial* serial);
+void serial_init(Serial* serial, Scheduler* scheduler);
 void serial_write(Serial* serial, uint16_t address, uint8_t data);
 uint8_t serial_read(Serial* serial, uint16_t address);
 
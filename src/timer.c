@@ -2,25 +2,74 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-void timer_init(Timer* timer) {
-    if (!timer) {abort();}
+void timer_init(Timer* timer, Scheduler* scheduler) {
+    if (!timer || !scheduler) {abort();}
 
+    timer->scheduler = scheduler;
+    timer->last_sync = scheduler->now;
+    timer->div_origin = scheduler->now - 0xAB00; //DIV starts at 0xAB
     timer->clock_speed = 1024; //clock ticks number to increment tima
-    timer->div = 0xAB;
-    timer->div_cycles = 0;
     timer->tac = 0;
     timer->tima = 0;
-    timer->tima_cycles = 0;
     timer->tma = 0;
     timer->enabled = false;
     timer->interrupt = 0;
 }
 
+//the divider counts from 0 at power on, timer_init starts it where the boot ROM leaves it
+void timer_power_on(Timer* timer) {
+    if (!timer) {abort();}
+
+    timer->div_origin = timer->scheduler->now;
+}
+
+static uint16_t timer_divider(Timer* timer, uint64_t when) {
+    return (uint16_t)(when - timer->div_origin);
+}
+
+//TIMA is incremented on the falling edges of this signal: enabled AND the divider bit selected by TAC
+static bool timer_signal(Timer* timer) {
+    return timer->enabled && (timer_divider(timer, timer->scheduler->now) & (timer->clock_speed >> 1));
+}
+
+static void timer_increment(Timer* timer, uint64_t increments) {
+    uint64_t to_overflow = 0x100 - timer->tima;
+    if (increments < to_overflow) { timer->tima += increments; return; }
+
+    increments -= to_overflow;
+    timer->tima = timer->tma + increments % (0x100 - timer->tma); //more than one overflow only if EVENT_TIMER was late
+    timer->interrupt = 0x4;
+}
+
+//apply the TIMA increments of the divider falling edges since the last sync
+static void timer_sync(Timer* timer) {
+    uint64_t now = timer->scheduler->now;
+    if (timer->enabled) {
+        uint64_t phase = timer_divider(timer, timer->last_sync) & (timer->clock_speed - 1);
+        timer_increment(timer, (phase + now - timer->last_sync) / timer->clock_speed);
+    }
+    timer->last_sync = now;
+}
+
+//cycles before TIMA overflows and requests its interrupt, EVENT_NEVER if the timer is stopped
+static uint64_t timer_cycles_to_interrupt(Timer* timer) {
+    if (timer->enabled == false) { return EVENT_NEVER; }
+
+    uint64_t phase = timer_divider(timer, timer->scheduler->now) & (timer->clock_speed - 1);
+    return (uint64_t)(0xFF - timer->tima) * timer->clock_speed + (timer->clock_speed - phase);
+}
+
+static void timer_reschedule(Timer* timer) {
+    uint64_t cycles = timer_cycles_to_interrupt(timer);
+    scheduler_schedule(timer->scheduler, EVENT_TIMER, (cycles == EVENT_NEVER) ? EVENT_NEVER : timer->scheduler->now + cycles);
+}
+
 uint8_t timer_read(Timer* timer, uint16_t address) {
     if (!timer) {abort();}
 
+    timer_sync(timer);
     switch (address) {
-        case 0xFF04: { return timer->div; }
+        case 0xFF04: { return timer_divider(timer, timer->scheduler->now) >> 8; }
         case 0xFF05: { return timer->tima; }
         case 0xFF06: { return timer->tma; }
         case 0xFF07: { return timer->tac; }
@@ -30,41 +79,33 @@ uint8_t timer_read(Timer* timer, uint16_t address) {
 void timer_write(Timer* timer, uint16_t address, uint8_t data) {
     if (!timer) {abort();}
 
+    timer_sync(timer);
     switch(address) {
-        case 0xFF04: { timer->div = 0; return; }
-        case 0xFF05: { timer->tima = data; return; }
-        case 0xFF06: { timer->tma = data; return; }
-        case 0xFF07: { timer->tac = (data | 0xF8); timer->enabled = (data & 0x4) != 0; switch (data & 0x3) { //0xF8 mask is to put useless bit to 1 and only get useful bit from data
+        case 0xFF04: { if (timer_signal(timer)) { timer_increment(timer, 1); } //resetting the divider can make the signal fall
+                       timer->div_origin = timer->scheduler->now; break; }
+        case 0xFF05: { timer->tima = data; break; }
+        case 0xFF06: { timer->tma = data; break; }
+        case 0xFF07: { bool signal = timer_signal(timer);
+                       timer->tac = (data | 0xF8); timer->enabled = (data & 0x4) != 0; switch (data & 0x3) { //0xF8 mask is to put useless bit to 1 and only get useful bit from data
                                                                         case 0x0: {timer->clock_speed = 1024; break; }
                                                                         case 0x1: {timer->clock_speed = 16; break; }
                                                                         case 0x2: {timer->clock_speed = 64; break; }
                                                                         case 0x3: {timer->clock_speed = 256; break; }
                                                                         default: {abort();}; }
-                    return;
+                    if (signal && !timer_signal(timer)) { timer_increment(timer, 1); } //disabling or switching bit can make the signal fall
+                    break;
                     }
         default : {fprintf(stderr, "Error : invalid address to write timer"); abort();}
     }
+
+    if (timer->interrupt) { scheduler_schedule(timer->scheduler, EVENT_TIMER, timer->scheduler->now); } //a falling edge glitch overflowed TIMA
+    else { timer_reschedule(timer); } //the next overflow moved
 }
 
-void timer_ticks(Timer* timer, uint32_t ticks) {
+//EVENT_TIMER: TIMA overflowed, timer->interrupt is set
+void timer_event(Timer* timer) {
     if (!timer) {abort();}
 
-    timer->div_cycles += ticks;
-
-    while( timer->div_cycles >= 256) {
-        timer->div++;
-        timer->div_cycles -= 256;
-    }
-
-    if (timer->enabled == false) { return ;}
-
-    timer->tima_cycles += ticks;
-    while (timer->tima_cycles >= timer->clock_speed) {
-        timer->tima++;
-        if (timer->tima == 0x00) {
-            timer->tima = timer->tma;
-            timer->interrupt = 0x4;
-        }
-        timer->tima_cycles -= timer->clock_speed;
-    }
+    timer_sync(timer);
+    timer_reschedule(timer);
 }
\ No newline at end of file
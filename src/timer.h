@@ -3,26 +3,29 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "scheduler.h"
 
+//DIV and TIMA are derived from the scheduler clock when they are accessed, nothing runs between the accesses
 typedef struct {
-    uint8_t div;
     uint8_t tima;
     uint8_t tma;
     uint8_t tac;
 
-    uint32_t clock_speed;
+    uint32_t clock_speed; //cycles between two TIMA increments, twice the divider bit TAC selects
     bool enabled;
 
-    uint32_t div_cycles;
-    uint32_t tima_cycles;
-
     uint8_t interrupt;
+
+    Scheduler* scheduler;
+    uint64_t div_origin; //the 16 bits internal divider is (now - div_origin), DIV is its upper byte
+    uint64_t last_sync; //scheduler timestamp tima is up to date at
 } Timer;
 
-void timer_init(Timer* timer);
+void timer_init(Timer* timer, Scheduler* scheduler);
+void timer_power_on(Timer* timer);
 uint8_t timer_read(Timer* timer, uint16_t address);
 void timer_write(Timer* timer, uint16_t address, uint8_t data);
 
-void timer_ticks(Timer* timer, uint32_t ticks);
+void timer_event(Timer* timer);
 
-#endif
\ No newline at end of file
+#endif